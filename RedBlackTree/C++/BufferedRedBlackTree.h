@@ -0,0 +1,166 @@
+/**
+ * Buffered Red Black Tree H
+ * by Flower Black
+ * 2022.1
+ * at Yushan County, Shangrao, Jiangxi
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include "RedBlackTree.hpp"
+
+/**
+ * 带写缓冲的红黑树。
+ * 
+ * setData 只把元素追加到缓冲区末尾，不排序、不查找，每次写入都是 O(1).
+ * 缓冲区满、手动 flush 或者有读和删除操作时，先把缓冲区排序一次（同一个键以最后写入的为准），
+ * 再一趟合并进树中：
+ *   1. 有序的一批键相对树较大时（包括树为空），把树的节点与新节点按键归并，
+ *      直接重新链接成一棵平衡的红黑树，整批写入是 O(n + m)，不需要旋转。
+ *   2. 否则每个键都从上一个写入的节点附近开始查找，下降路径短，且大多命中缓存。
+ * 
+ * 适合连续写入很多元素、之后再读的负载。读、写频繁交替时每次读都会清空一个很小的缓冲区，
+ * 性能与直接使用 RedBlackTree 相当。
+ */
+template <typename KeyType, typename DataType>
+class BufferedRedBlackTree {
+
+public:
+	/** 树的生命相关操作。 */
+
+	/**
+	 * @param bufferCapacity 缓冲区最多容纳的元素数。为 0 时不缓冲，setData 直接写入树。
+	 *        随机键需要较大的缓冲区（数万）才能体现出批量写入的优势。缓冲区按需增长。
+	 */
+	explicit BufferedRedBlackTree(size_t bufferCapacity = 1 << 16);
+	~BufferedRedBlackTree();
+
+	/**
+	 * 清空树与缓冲区中所有元素。
+	 */
+	void clear();
+
+public:
+	/** 树的基本查询操作。 */
+
+	/**
+	 * 判断键是否在树里。会先把缓冲区写入树。
+	 * 
+	 * @param queryKey 待判断的键。
+	 * @return 是否找到了对应键。
+	 */
+	bool hasKey(const KeyType& queryKey);
+
+	/**
+	 * 根据键获取数据。会先把缓冲区写入树。
+	 * 
+	 * @param key 键。
+	 * @return 键对应的数据。
+	 * @exception runtime_error 如果无法找到键，会抛出异常。
+	 */
+	DataType& getData(const KeyType& key);
+
+	/**
+	 * 设置数据。数据追加到缓冲区；缓冲区满时，将缓冲区写入树。
+	 * 
+	 * @param key 键。
+	 * @param data 数据。
+	 * @return 对象自身。
+	 */
+	BufferedRedBlackTree<KeyType, DataType>& setData(const KeyType& key, const DataType& data);
+
+	/**
+	 * 删除键。会先把缓冲区写入树。
+	 * 
+	 * @param key 键。
+	 * @return 对象自身。
+	 * @exception runtime_error 如果无法找到键，会抛出异常。
+	 */
+	BufferedRedBlackTree<KeyType, DataType>& removeKey(const KeyType& key);
+
+public:
+	/** 缓冲区操作。 */
+
+	/**
+	 * 将缓冲区排序后一趟写入树，并清空缓冲区。
+	 * 写入失败（内存不足等）时，树与缓冲区都保持不变。
+	 * 
+	 * @return 对象自身。
+	 */
+	BufferedRedBlackTree<KeyType, DataType>& flush();
+
+	/**
+	 * 缓冲区中的元素数。
+	 */
+	size_t getBufferedCount() const;
+
+	/**
+	 * 写入缓冲区后，获取底层的树。用于遍历、最值等有序操作。
+	 * 
+	 * @return 底层的树。
+	 */
+	RedBlackTree<KeyType, DataType>& getTree();
+
+	/**
+	 * 写入缓冲区后，按键从小到大的顺序访问每个元素。
+	 * 
+	 * @param function 访问函数，形如 void(const KeyType& key, DataType& data)。
+	 */
+	template <typename Function>
+	void forEach(Function&& function);
+
+private:
+	using BufferEntry = std::pair<KeyType, DataType>;
+	using Node = typename RedBlackTree<KeyType, DataType>::Node;
+
+	/**
+	 * 有序的一批键数乘以该值不小于树的节点数时，用归并重建的方式写入。
+	 * 逐个插入约需 m log n 次比较，重建需要 n + m 次，取个保守的分界。
+	 */
+	static constexpr size_t REBUILD_RATIO = 4;
+
+	/**
+	 * 按键排序缓冲区，同一个键只保留最后写入的一项。
+	 */
+	void sortBuffer();
+
+	/**
+	 * 判断树的节点数是否不超过 limit. 最多访问 limit + 1 个节点。
+	 */
+	bool isTreeSmallerThan(size_t limit) const;
+
+	/**
+	 * 逐个写入：每个键都从上一个写入的节点附近开始查找。
+	 */
+	void mergeNearHint();
+
+	/**
+	 * 归并重建：把树的节点与缓冲区按键归并，重新链接成平衡的红黑树。
+	 */
+	void mergeAndRebuild();
+
+	/**
+	 * 把有序的节点链接成平衡的子树。
+	 * 深度为 redDepth 的节点设为红色，其余为黑色。这样所有路径上的黑色节点数相同。
+	 * 
+	 * @return 子树的根。
+	 */
+	static Node* linkBalanced(
+		std::vector<Node*>& nodes, size_t begin, size_t end, Node* father, size_t depth, size_t redDepth
+	);
+
+private:
+	RedBlackTree<KeyType, DataType> tree;
+
+	/**
+	 * 缓冲区。按写入的顺序排列，写入树前才排序。
+	 */
+	std::vector<BufferEntry> buffer;
+
+	size_t bufferCapacity;
+
+};
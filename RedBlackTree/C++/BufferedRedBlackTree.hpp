@@ -0,0 +1,274 @@
+/**
+ * Buffered Red Black Tree Hpp
+ * by Flower Black
+ * 2022.1
+ * at Yushan County, Shangrao, Jiangxi
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <utility>
+
+#include "BufferedRedBlackTree.h"
+
+template<typename KeyType, typename DataType>
+BufferedRedBlackTree<KeyType, DataType>::BufferedRedBlackTree(size_t bufferCapacity)
+	: bufferCapacity(bufferCapacity)
+{
+}
+
+template<typename KeyType, typename DataType>
+BufferedRedBlackTree<KeyType, DataType>::~BufferedRedBlackTree()
+{
+}
+
+template<typename KeyType, typename DataType>
+void BufferedRedBlackTree<KeyType, DataType>::clear()
+{
+	this->buffer.clear();
+	this->tree.clear();
+}
+
+template<typename KeyType, typename DataType>
+bool BufferedRedBlackTree<KeyType, DataType>::hasKey(const KeyType& queryKey)
+{
+	this->flush();
+	return this->tree.hasKey(queryKey);
+}
+
+template<typename KeyType, typename DataType>
+DataType& BufferedRedBlackTree<KeyType, DataType>::getData(const KeyType& key)
+{
+	this->flush();
+	return this->tree.getData(key);
+}
+
+template<typename KeyType, typename DataType>
+BufferedRedBlackTree<KeyType, DataType>& BufferedRedBlackTree<KeyType, DataType>::setData(
+	const KeyType& key, 
+	const DataType& data
+)
+{
+	if (this->bufferCapacity == 0) {
+		this->tree.setData(key, data);
+		return *this;
+	}
+
+	this->buffer.emplace_back(key, data);
+	if (this->buffer.size() >= this->bufferCapacity) {
+		this->flush();
+	}
+	return *this;
+}
+
+template<typename KeyType, typename DataType>
+BufferedRedBlackTree<KeyType, DataType>& BufferedRedBlackTree<KeyType, DataType>::removeKey(
+	const KeyType& key
+)
+{
+	this->flush();
+	this->tree.removeKey(key);
+	return *this;
+}
+
+template<typename KeyType, typename DataType>
+BufferedRedBlackTree<KeyType, DataType>& BufferedRedBlackTree<KeyType, DataType>::flush()
+{
+	if (this->buffer.empty()) {
+		return *this;
+	}
+
+	this->sortBuffer();
+
+	if (this->isTreeSmallerThan(this->buffer.size() * REBUILD_RATIO)) {
+		this->mergeAndRebuild();
+	}
+	else {
+		this->mergeNearHint();
+	}
+
+	this->buffer.clear();
+	return *this;
+}
+
+template<typename KeyType, typename DataType>
+void BufferedRedBlackTree<KeyType, DataType>::sortBuffer()
+{
+	// 稳定排序保证同一个键的各项仍按写入顺序排列，最后一项就是最新的。
+	std::stable_sort(
+		this->buffer.begin(), this->buffer.end(),
+		[] (const BufferEntry& a, const BufferEntry& b) {
+			return a.first < b.first;
+		}
+	);
+
+	size_t keptCount = 0;
+	for (size_t i = 0; i < this->buffer.size(); i++) {
+		if (keptCount > 0 && this->buffer[keptCount - 1].first == this->buffer[i].first) {
+			this->buffer[keptCount - 1].second = std::move(this->buffer[i].second);
+		}
+		else {
+			if (keptCount != i) {
+				this->buffer[keptCount] = std::move(this->buffer[i]);
+			}
+			keptCount++;
+		}
+	}
+	this->buffer.erase(this->buffer.begin() + keptCount, this->buffer.end());
+}
+
+template<typename KeyType, typename DataType>
+bool BufferedRedBlackTree<KeyType, DataType>::isTreeSmallerThan(size_t limit) const
+{
+	size_t count = 0;
+	for (Node* node = this->tree.leftmostNode; node != nullptr; node = RedBlackTree<KeyType, DataType>::successorOf(node)) {
+		if (++count > limit) {
+			return false;
+		}
+	}
+	return true;
+}
+
+template<typename KeyType, typename DataType>
+void BufferedRedBlackTree<KeyType, DataType>::mergeNearHint()
+{
+	// 缓冲区已按键排序。每次从上一个写入的节点附近开始查找。
+	Node* hint = nullptr;
+	size_t flushedCount = 0;
+
+	try {
+		for (BufferEntry& entry : this->buffer) {
+			bool created;
+			hint = this->tree.findOrCreateNodeNear(hint, entry.first, created);
+			hint->data = std::move(entry.second);
+			flushedCount++;
+		}
+	}
+	catch (...) {
+		// 已写入树的部分从缓冲区中移除，其余留在缓冲区里。
+		this->buffer.erase(this->buffer.begin(), this->buffer.begin() + flushedCount);
+		throw;
+	}
+}
+
+template<typename KeyType, typename DataType>
+void BufferedRedBlackTree<KeyType, DataType>::mergeAndRebuild()
+{
+	/*
+		第一步按键归并树的节点与缓冲区，为树中没有的键创建节点。
+		这一步可能失败（分配节点、拷贝键、哈希索引扩容），此时销毁新建的节点即可，树与缓冲区不变。
+		之后只移动数据、改写指针，不会失败。
+	*/
+	std::vector<Node*> nodes;
+	std::vector<Node*> targets; // 缓冲区每一项要写入的节点。
+	std::vector<Node*> createdNodes;
+
+	try {
+		nodes.reserve(this->buffer.size() * (REBUILD_RATIO + 1));
+		targets.reserve(this->buffer.size());
+		createdNodes.reserve(this->buffer.size());
+
+		Node* treeNode = this->tree.leftmostNode;
+		for (BufferEntry& entry : this->buffer) {
+			while (treeNode != nullptr && treeNode->key < entry.first) {
+				nodes.push_back(treeNode);
+				treeNode = RedBlackTree<KeyType, DataType>::successorOf(treeNode);
+			}
+
+			if (treeNode != nullptr && treeNode->key == entry.first) {
+				nodes.push_back(treeNode);
+				targets.push_back(treeNode);
+				treeNode = RedBlackTree<KeyType, DataType>::successorOf(treeNode);
+				continue;
+			}
+
+			Node* node = this->tree.createNode();
+			try {
+				node->key = entry.first;
+				node->setKeyPrefix(node->key);
+				this->tree.hashIndexInsert(node);
+			}
+			catch (...) {
+				this->tree.destroyNode(node);
+				throw;
+			}
+			createdNodes.push_back(node);
+			nodes.push_back(node);
+			targets.push_back(node);
+		}
+		for (; treeNode != nullptr; treeNode = RedBlackTree<KeyType, DataType>::successorOf(treeNode)) {
+			nodes.push_back(treeNode);
+		}
+	}
+	catch (...) {
+		for (Node* node : createdNodes) {
+			this->tree.hashIndexErase(node);
+			this->tree.destroyNode(node);
+		}
+		throw;
+	}
+
+	for (size_t i = 0; i < this->buffer.size(); i++) {
+		targets[i]->data = std::move(this->buffer[i].second);
+	}
+
+	// 节点数为 n 时，从中间对半分得到的树，空孩子的深度只差一层，最深一层的深度为 floor(log2 n).
+	size_t redDepth = 0;
+	while ((size_t(2) << redDepth) <= nodes.size()) {
+		redDepth++;
+	}
+
+	Node* root = linkBalanced(nodes, 0, nodes.size(), nullptr, 0, redDepth);
+	root->color = RedBlackTree<KeyType, DataType>::NodeColor::BLACK;
+	this->tree.root = root;
+	this->tree.leftmostNode = nodes.front();
+	this->tree.rightmostNode = nodes.back();
+}
+
+template<typename KeyType, typename DataType>
+typename BufferedRedBlackTree<KeyType, DataType>::Node* BufferedRedBlackTree<KeyType, DataType>::linkBalanced(
+	std::vector<Node*>& nodes,
+	size_t begin,
+	size_t end,
+	Node* father,
+	size_t depth,
+	size_t redDepth
+)
+{
+	if (begin == end) {
+		return nullptr;
+	}
+
+	// 递归深度为树高，不超过 log2 n.
+	size_t middle = begin + (end - begin) / 2;
+	Node* node = nodes[middle];
+	node->father = father;
+	node->color = (depth == redDepth
+		? RedBlackTree<KeyType, DataType>::NodeColor::RED
+		: RedBlackTree<KeyType, DataType>::NodeColor::BLACK);
+	node->leftChild = linkBalanced(nodes, begin, middle, node, depth + 1, redDepth);
+	node->rightChild = linkBalanced(nodes, middle + 1, end, node, depth + 1, redDepth);
+	return node;
+}
+
+template<typename KeyType, typename DataType>
+size_t BufferedRedBlackTree<KeyType, DataType>::getBufferedCount() const
+{
+	return this->buffer.size();
+}
+
+template<typename KeyType, typename DataType>
+RedBlackTree<KeyType, DataType>& BufferedRedBlackTree<KeyType, DataType>::getTree()
+{
+	this->flush();
+	return this->tree;
+}
+
+template<typename KeyType, typename DataType>
+template<typename Function>
+void BufferedRedBlackTree<KeyType, DataType>::forEach(Function&& function)
+{
+	this->flush();
+	this->tree.forEach(std::forward<Function>(function));
+}
@@ -0,0 +1,213 @@
+/**
+ * Concurrent Red Black Tree H
+ * by Flower Black
+ * 2022.1
+ * at Yushan County, Shangrao, Jiangxi
+ */
+
+#pragma once
+
+#include <atomic>
+
+#include "RedBlackTreeNodeData.h"
+
+/**
+ * 支持多个线程同时读写的红黑树。
+ * 
+ * 使用与 TopDownRedBlackTree 相同的自顶向下单趟算法。
+ * 平衡修复只涉及当前位置附近的几个节点，因此可以用“手递手”加锁（lock coupling）：
+ * 每个节点有一把自旋锁，线程沿查找路径向下移动时，先锁住下一个节点，再释放离开窗口的节点。
+ * 不同线程在树中的不同区域可以同时修改，只在经过树的上层时短暂地相互等待。
+ * 
+ * 加锁规则：只有在持有某节点的父节点的锁时，才能去锁该节点。
+ * 因此线程只会等待自己所持节点的孩子（或兄弟的孩子）；若线程甲持有父节点而线程乙持有孩子，
+ * 说明乙先经过了这里，已经走到甲的前面（更深处），之后只会继续向下，不会回头等待甲。
+ * 
+ * 查找与插入持有的锁从上到下连成一片。删除找到目标节点后会一直持有它，
+ * 而它与窗口之间的节点会被释放，此时持有的锁分成两部分：目标节点，以及它子树中连成一片的窗口。
+ * 这之后删除需要锁住的节点（包括旋转涉及的节点）全部在目标节点的子树中；
+ * 其他线程要进入这棵子树必须先锁住目标节点，因此不会有新的线程从上方进入。
+ * 等待目标节点的线程只持有子树外的节点，删除线程不会去等它们。
+ * 所以等待关系不会成环，不会死锁。
+ */
+template <typename KeyType, typename DataType>
+class ConcurrentRedBlackTree {
+
+public:
+	/** 树的生命相关操作。 */
+	ConcurrentRedBlackTree();
+	~ConcurrentRedBlackTree();
+
+	ConcurrentRedBlackTree(const ConcurrentRedBlackTree&) = delete;
+	ConcurrentRedBlackTree& operator = (const ConcurrentRedBlackTree&) = delete;
+
+	/**
+	 * 清空树中所有元素。调用时不能有其他线程在访问这棵树。
+	 */
+	void clear();
+
+public:
+	/** 树的基本查询操作。以下操作都可以被多个线程同时调用。 */
+
+	/**
+	 * 判断键是否在树里。
+	 * 
+	 * @param queryKey 待判断的键。
+	 * @return 是否在树上找到了对应键。
+	 */
+	bool hasKey(const KeyType& queryKey);
+
+	/**
+	 * 根据键获取数据。由于其他线程可能同时修改树，返回的是数据的拷贝。
+	 * 
+	 * @param key 键。
+	 * @return 键对应的数据。
+	 * @exception runtime_error 如果无法找到键，会抛出异常。
+	 */
+	DataType getData(const KeyType& key);
+
+	/**
+	 * 设置数据。如果键已经存在，会更新原有数据。
+	 * 
+	 * @param key 键。
+	 * @param data 数据。
+	 */
+	ConcurrentRedBlackTree<KeyType, DataType>& setData(const KeyType& key, const DataType& data);
+
+	/**
+	 * 删除键。
+	 * 找不到键时，树的内容不变，但向下途中做过的旋转和着色会保留（树依然合法）。
+	 * 
+	 * @param key 键。
+	 * @return 红黑树对象自身。
+	 * @exception runtime_error 如果无法找到键，会抛出异常。
+	 */
+	ConcurrentRedBlackTree<KeyType, DataType>& removeKey(const KeyType& key);
+
+public:
+	/** 调试操作。 */
+
+	/**
+	 * 检查红黑树的性质：键有序，根为黑色，红色节点没有红色孩子，各路径黑色节点数相同。
+	 * 调用时不能有其他线程在修改这棵树。
+	 * 
+	 * @return 是否满足全部性质。
+	 */
+	bool checkInvariants();
+
+private:
+	enum class NodeColor {
+		RED, BLACK
+	};
+
+	/**
+	 * 节点锁。只占一个字节，可以放进节点的填充空间里。
+	 * 等待时让出处理器，临界区都很短。
+	 */
+	class NodeLock {
+	public:
+		void lock();
+		void unlock();
+
+	private:
+		std::atomic_flag flag = ATOMIC_FLAG_INIT;
+	};
+
+	struct Node : RedBlackTreeNodeData<DataType> {
+		KeyType key;
+		NodeColor color = NodeColor::RED;
+		NodeLock lock;
+
+		/**
+		 * children[0] 为左孩子，children[1] 为右孩子。
+		 */
+		Node* children[2] = { nullptr, nullptr };
+	};
+
+	/**
+	 * 当前线程持有的节点锁。
+	 * 窗口中的节点数很少，线性查找即可。析构时释放所有锁，抛出异常时也不会遗漏。
+	 */
+	class HeldLocks {
+	public:
+		~HeldLocks();
+
+		/**
+		 * 锁住节点。已经持有或节点为空时什么都不做。
+		 */
+		void acquire(Node* node);
+
+		/**
+		 * 释放一个节点的锁。没有持有时什么都不做。
+		 */
+		void release(Node* node);
+
+		/**
+		 * 只保留给定节点的锁，释放其他所有锁。
+		 */
+		void retain(Node* first, Node* second, Node* third, Node* fourth);
+
+		/**
+		 * 释放所有锁。
+		 */
+		void releaseAll();
+
+	private:
+		/**
+		 * 同时持有的锁的上限。删除时最多持有：祖父、父、当前节点及其两个孩子、
+		 * 兄弟及其两个孩子、目标节点，共 9 个。
+		 */
+		static constexpr int MAX_HELD_LOCKS = 12;
+
+		Node* nodes[MAX_HELD_LOCKS];
+		int count = 0;
+	};
+
+private:
+	/**
+	 * 判断节点是否为红色。空节点视为黑色。
+	 */
+	static bool isRed(const Node* node);
+
+	/**
+	 * 单旋转。node 的 !direction 侧孩子成为子树新的根。
+	 * 旋转后，新根为黑色，原来的根为红色。
+	 * 
+	 * @param node 子树的根。
+	 * @param direction 旋转方向。0 为左旋，1 为右旋。
+	 * @return 子树新的根。
+	 */
+	static Node* rotateSingle(Node* node, int direction);
+
+	/**
+	 * 双旋转：先对 !direction 侧孩子做反向单旋转，再对 node 做单旋转。
+	 * 
+	 * @param node 子树的根。
+	 * @param direction 旋转方向。
+	 * @return 子树新的根。
+	 */
+	static Node* rotateDouble(Node* node, int direction);
+
+	/**
+	 * 检查以 node 为根的子树。
+	 * 
+	 * @param node 子树的根。
+	 * @param lowerBound 子树中的键必须大于它。为 nullptr 时不限制。
+	 * @param upperBound 子树中的键必须小于它。为 nullptr 时不限制。
+	 * @return 子树的黑色高度。不满足性质时返回 -1.
+	 */
+	static int checkSubtree(const Node* node, const KeyType* lowerBound, const KeyType* upperBound);
+
+	/**
+	 * 将根节点设为黑色。调用时不能持有任何锁。
+	 * 把根从红色变为黑色，所有路径的黑色节点数同时加一，不破坏任何性质。
+	 */
+	void blackenRoot();
+
+private:
+	/**
+	 * 假的树根。它的右孩子是真正的根。它的锁同时保护根指针。
+	 */
+	Node head;
+
+};
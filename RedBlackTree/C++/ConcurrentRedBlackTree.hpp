@@ -0,0 +1,482 @@
+/**
+ * Concurrent Red Black Tree Hpp
+ * by Flower Black
+ * 2022.1
+ * at Yushan County, Shangrao, Jiangxi
+ */
+
+#pragma once
+
+#include <cassert>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+#include "ConcurrentRedBlackTree.h"
+
+template<typename KeyType, typename DataType>
+ConcurrentRedBlackTree<KeyType, DataType>::ConcurrentRedBlackTree()
+{
+	this->head.color = NodeColor::BLACK; // 假树根不能参与“连续红色节点”的判断。
+}
+
+template<typename KeyType, typename DataType>
+ConcurrentRedBlackTree<KeyType, DataType>::~ConcurrentRedBlackTree()
+{
+	this->clear();
+}
+
+template<typename KeyType, typename DataType>
+void ConcurrentRedBlackTree<KeyType, DataType>::clear()
+{
+	Node* currentNode = this->head.children[1];
+
+	// 不断右旋，把树拉成链再逐个释放。
+	while (currentNode != nullptr) {
+		if (currentNode->children[0] != nullptr) {
+			Node* leftChild = currentNode->children[0];
+			currentNode->children[0] = leftChild->children[1];
+			leftChild->children[1] = currentNode;
+			currentNode = leftChild;
+		}
+		else {
+			Node* rightChild = currentNode->children[1];
+			delete currentNode;
+			currentNode = rightChild;
+		}
+	}
+
+	this->head.children[1] = nullptr;
+}
+
+template<typename KeyType, typename DataType>
+bool ConcurrentRedBlackTree<KeyType, DataType>::hasKey(const KeyType& queryKey)
+{
+	HeldLocks held;
+	held.acquire(&this->head);
+
+	Node* father = &this->head;
+	Node* currentNode = this->head.children[1];
+
+	while (currentNode != nullptr) {
+		held.acquire(currentNode);
+		held.release(father);
+
+		if (queryKey == currentNode->key) {
+			return true; // 找到对应键。
+		}
+
+		father = currentNode;
+		if (queryKey < currentNode->key) {
+			currentNode = currentNode->children[0]; // 目标键小于当前键，向左查找。
+		}
+		else {
+			currentNode = currentNode->children[1]; // 目标键大于当前键，向右查找。
+		}
+	}
+
+	return false; // 找不到键。
+}
+
+template<typename KeyType, typename DataType>
+DataType ConcurrentRedBlackTree<KeyType, DataType>::getData(const KeyType& key)
+{
+	HeldLocks held;
+	held.acquire(&this->head);
+
+	Node* father = &this->head;
+	Node* currentNode = this->head.children[1];
+
+	while (currentNode != nullptr) {
+		held.acquire(currentNode);
+		held.release(father);
+
+		if (key == currentNode->key) {
+			return currentNode->data; // 找到对应键。
+		}
+
+		father = currentNode;
+		if (key < currentNode->key) {
+			currentNode = currentNode->children[0]; // 目标键小于当前键，向左查找。
+		}
+		else {
+			currentNode = currentNode->children[1]; // 目标键大于当前键，向右查找。
+		}
+	}
+
+	throw std::runtime_error("could not find your key in the object."); // 找不到对应键。抛出异常。
+}
+
+template<typename KeyType, typename DataType>
+ConcurrentRedBlackTree<KeyType, DataType>& ConcurrentRedBlackTree<KeyType, DataType>::setData(
+	const KeyType& key,
+	const DataType& data
+)
+{
+	HeldLocks held;
+	held.acquire(&this->head);
+
+	Node* root = this->head.children[1];
+
+	// 如果树是空的，插入节点设为根即可。
+	if (root == nullptr) {
+		root = new Node;
+		root->key = key;
+		root->data = data;
+		root->color = NodeColor::BLACK;
+		this->head.children[1] = root;
+		return *this;
+	}
+
+	// 其他线程的删除操作可能让根变成红色。自顶向下插入要求开始时根为黑色。
+	held.acquire(root);
+	root->color = NodeColor::BLACK;
+
+	/*
+		与 TopDownRedBlackTree::setData 相同：向下途中反色，出现“连续红色节点”时在祖父处旋转。
+		窗口为 曾祖父、祖父、父节点、当前节点，外加检查颜色时锁住的当前节点的两个孩子。
+		旋转和着色只涉及窗口中的节点，因此它们被锁住时，其他线程看不到中间状态。
+	*/
+	Node* greatGrandpa = &this->head;
+	Node* grandpa = nullptr;
+	Node* father = nullptr;
+	Node* currentNode = root;
+	Node* createdNode = nullptr;
+	int direction = 0;
+	int lastDirection = 0;
+
+	while (true) {
+		if (currentNode == nullptr) {
+			// 到达底部，插入红色的新节点。先锁住它再挂到树上。
+			currentNode = new Node;
+			createdNode = currentNode;
+			currentNode->key = key;
+			currentNode->data = data;
+			held.acquire(currentNode);
+			father->children[direction] = currentNode;
+		}
+		else {
+			held.acquire(currentNode->children[0]);
+			held.acquire(currentNode->children[1]);
+
+			if (isRed(currentNode->children[0]) && isRed(currentNode->children[1])) {
+				// 反色。
+				currentNode->color = NodeColor::RED;
+				currentNode->children[0]->color = NodeColor::BLACK;
+				currentNode->children[1]->color = NodeColor::BLACK;
+
+				if (father == nullptr) {
+					// 当前节点是根（第一轮循环时父节点还是 nullptr）。
+					// 根节点反色后立即恢复黑色。此时还持有假树根的锁，其他线程看不到红色的根。
+					currentNode->color = NodeColor::BLACK;
+				}
+			}
+		}
+
+		// 修复“连续红色节点”问题。父节点是红色的，所以祖父一定存在。
+		if (isRed(currentNode) && isRed(father)) {
+			int grandpaDirection = (greatGrandpa->children[1] == grandpa);
+
+			if (currentNode == father->children[lastDirection]) {
+				greatGrandpa->children[grandpaDirection] = rotateSingle(grandpa, !lastDirection);
+			}
+			else {
+				greatGrandpa->children[grandpaDirection] = rotateDouble(grandpa, !lastDirection);
+			}
+		}
+
+		if (key == currentNode->key) {
+			if (currentNode != createdNode) {
+				currentNode->data = data; // 键已经存在，更新数据。
+			}
+			break;
+		}
+
+		lastDirection = direction;
+		direction = (currentNode->key < key);
+
+		if (grandpa != nullptr) {
+			greatGrandpa = grandpa;
+		}
+		grandpa = father;
+		father = currentNode;
+		currentNode = currentNode->children[direction];
+
+		// 下一个节点已经作为孩子被锁住了。释放离开窗口的节点。
+		held.retain(greatGrandpa, grandpa, father, currentNode);
+	}
+
+	return *this;
+}
+
+template<typename KeyType, typename DataType>
+ConcurrentRedBlackTree<KeyType, DataType>& ConcurrentRedBlackTree<KeyType, DataType>::removeKey(
+	const KeyType& key
+)
+{
+	bool found = false;
+
+	{
+		HeldLocks held;
+		held.acquire(&this->head);
+		held.acquire(this->head.children[1]);
+
+		/*
+			与 TopDownRedBlackTree::removeKey 相同：向下途中把红色推下来，最后删掉的节点一定是红色。
+			窗口为 祖父、父节点、当前节点及其两个孩子；推红色时还要锁住兄弟和兄弟的两个孩子。
+			找到目标节点后一直持有它的锁，直到把前驱的内容移进去。
+		*/
+		Node* grandpa = nullptr;
+		Node* father = nullptr;
+		Node* currentNode = &this->head;
+		Node* foundNode = nullptr;
+		int direction = 1;
+
+		while (currentNode->children[direction] != nullptr) {
+			int lastDirection = direction;
+
+			grandpa = father;
+			father = currentNode;
+			currentNode = currentNode->children[direction];
+
+			// 当前节点已经作为孩子被锁住了。释放离开窗口的节点。
+			held.retain(grandpa, father, currentNode, foundNode);
+
+			direction = (currentNode->key < key);
+			if (key == currentNode->key) {
+				foundNode = currentNode;
+			}
+
+			held.acquire(currentNode->children[0]);
+			held.acquire(currentNode->children[1]);
+
+			if (!isRed(currentNode) && !isRed(currentNode->children[direction])) {
+				if (isRed(currentNode->children[!direction])) {
+					father->children[lastDirection] = rotateSingle(currentNode, direction);
+					father = father->children[lastDirection];
+				}
+				else {
+					Node* sibling = father->children[!lastDirection];
+
+					if (sibling != nullptr) {
+						held.acquire(sibling);
+						held.acquire(sibling->children[0]);
+						held.acquire(sibling->children[1]);
+
+						if (!isRed(sibling->children[!lastDirection]) && !isRed(sibling->children[lastDirection])) {
+							father->color = NodeColor::BLACK;
+							sibling->color = NodeColor::RED;
+							currentNode->color = NodeColor::RED;
+						}
+						else {
+							int fatherDirection = (grandpa->children[1] == father);
+
+							if (isRed(sibling->children[lastDirection])) {
+								grandpa->children[fatherDirection] = rotateDouble(father, lastDirection);
+							}
+							else {
+								grandpa->children[fatherDirection] = rotateSingle(father, lastDirection);
+							}
+
+							Node* subtreeRoot = grandpa->children[fatherDirection];
+							currentNode->color = NodeColor::RED;
+							subtreeRoot->color = NodeColor::RED;
+							subtreeRoot->children[0]->color = NodeColor::BLACK;
+							subtreeRoot->children[1]->color = NodeColor::BLACK;
+						}
+					}
+				}
+			}
+		}
+
+		if (foundNode != nullptr) {
+			found = true;
+
+			if (foundNode != currentNode) {
+				foundNode->key = std::move(currentNode->key);
+				foundNode->data = std::move(currentNode->data);
+			}
+			father->children[father->children[1] == currentNode] =
+				currentNode->children[currentNode->children[0] == nullptr];
+
+			// 其他线程只能在持有父节点锁时等待它，而父节点在我们手上，所以没有人在等它。
+			held.release(currentNode);
+			delete currentNode;
+		}
+	}
+
+	// 删除途中的旋转可能让根变成红色。
+	this->blackenRoot();
+
+	if (!found) {
+		throw std::runtime_error("could not find your key in the object."); // 找不到对应键。抛出异常。
+	}
+
+	return *this;
+}
+
+template<typename KeyType, typename DataType>
+bool ConcurrentRedBlackTree<KeyType, DataType>::checkInvariants()
+{
+	Node* root = this->head.children[1];
+	if (isRed(root)) {
+		return false;
+	}
+
+	return checkSubtree(root, nullptr, nullptr) >= 0;
+}
+
+template<typename KeyType, typename DataType>
+void ConcurrentRedBlackTree<KeyType, DataType>::NodeLock::lock()
+{
+	while (this->flag.test_and_set(std::memory_order_acquire)) {
+		std::this_thread::yield();
+	}
+}
+
+template<typename KeyType, typename DataType>
+void ConcurrentRedBlackTree<KeyType, DataType>::NodeLock::unlock()
+{
+	this->flag.clear(std::memory_order_release);
+}
+
+template<typename KeyType, typename DataType>
+ConcurrentRedBlackTree<KeyType, DataType>::HeldLocks::~HeldLocks()
+{
+	this->releaseAll();
+}
+
+template<typename KeyType, typename DataType>
+void ConcurrentRedBlackTree<KeyType, DataType>::HeldLocks::acquire(Node* node)
+{
+	if (node == nullptr) {
+		return;
+	}
+
+	for (int i = 0; i < this->count; i++) {
+		if (this->nodes[i] == node) {
+			return; // 已经持有。
+		}
+	}
+
+	assert(this->count < MAX_HELD_LOCKS);
+
+	node->lock.lock();
+	this->nodes[this->count++] = node;
+}
+
+template<typename KeyType, typename DataType>
+void ConcurrentRedBlackTree<KeyType, DataType>::HeldLocks::release(Node* node)
+{
+	for (int i = 0; i < this->count; i++) {
+		if (this->nodes[i] == node) {
+			node->lock.unlock();
+			this->nodes[i] = this->nodes[--this->count];
+			return;
+		}
+	}
+}
+
+template<typename KeyType, typename DataType>
+void ConcurrentRedBlackTree<KeyType, DataType>::HeldLocks::retain(
+	Node* first,
+	Node* second,
+	Node* third,
+	Node* fourth
+)
+{
+	int i = 0;
+	while (i < this->count) {
+		Node* node = this->nodes[i];
+		if (node == first || node == second || node == third || node == fourth) {
+			i++;
+		}
+		else {
+			node->lock.unlock();
+			this->nodes[i] = this->nodes[--this->count];
+		}
+	}
+}
+
+template<typename KeyType, typename DataType>
+void ConcurrentRedBlackTree<KeyType, DataType>::HeldLocks::releaseAll()
+{
+	while (this->count > 0) {
+		this->nodes[--this->count]->lock.unlock();
+	}
+}
+
+template<typename KeyType, typename DataType>
+bool ConcurrentRedBlackTree<KeyType, DataType>::isRed(const Node* node)
+{
+	return node != nullptr && node->color == NodeColor::RED;
+}
+
+template<typename KeyType, typename DataType>
+typename ConcurrentRedBlackTree<KeyType, DataType>::Node* ConcurrentRedBlackTree<KeyType, DataType>::rotateSingle(
+	Node* node,
+	int direction
+)
+{
+	Node* targetRoot = node->children[!direction];
+
+	node->children[!direction] = targetRoot->children[direction];
+	targetRoot->children[direction] = node;
+
+	node->color = NodeColor::RED;
+	targetRoot->color = NodeColor::BLACK;
+
+	return targetRoot;
+}
+
+template<typename KeyType, typename DataType>
+typename ConcurrentRedBlackTree<KeyType, DataType>::Node* ConcurrentRedBlackTree<KeyType, DataType>::rotateDouble(
+	Node* node,
+	int direction
+)
+{
+	node->children[!direction] = rotateSingle(node->children[!direction], !direction);
+	return rotateSingle(node, direction);
+}
+
+template<typename KeyType, typename DataType>
+int ConcurrentRedBlackTree<KeyType, DataType>::checkSubtree(
+	const Node* node,
+	const KeyType* lowerBound,
+	const KeyType* upperBound
+)
+{
+	if (node == nullptr) {
+		return 1; // 空节点视为黑色。
+	}
+
+	if ((lowerBound != nullptr && !(*lowerBound < node->key))
+		|| (upperBound != nullptr && !(node->key < *upperBound)))
+	{
+		return -1; // 键的顺序错误。
+	}
+
+	if (isRed(node) && (isRed(node->children[0]) || isRed(node->children[1]))) {
+		return -1; // 连续红色节点。
+	}
+
+	int leftHeight = checkSubtree(node->children[0], lowerBound, &node->key);
+	int rightHeight = checkSubtree(node->children[1], &node->key, upperBound);
+	if (leftHeight < 0 || leftHeight != rightHeight) {
+		return -1; // 黑色高度不一致。
+	}
+
+	return leftHeight + (node->color == NodeColor::BLACK ? 1 : 0);
+}
+
+template<typename KeyType, typename DataType>
+void ConcurrentRedBlackTree<KeyType, DataType>::blackenRoot()
+{
+	HeldLocks held;
+	held.acquire(&this->head);
+	held.acquire(this->head.children[1]);
+
+	if (this->head.children[1] != nullptr) {
+		this->head.children[1]->color = NodeColor::BLACK;
+	}
+}
@@ -0,0 +1,198 @@
+/**
+ * Concurrent Red Black Tree Stress
+ * by Flower Black
+ * 2022.1
+ * at Yushan County, Shangrao, Jiangxi
+ */
+
+/*
+	ConcurrentRedBlackTree 的压力测试。多个线程同时增删查，每轮结束后检查红黑树的性质。
+
+	编译：g++ -std=c++17 -O2 -pthread ConcurrentRedBlackTreeStress.cpp -o ConcurrentRedBlackTreeStress
+	运行：./ConcurrentRedBlackTreeStress [线程数，默认 8] [轮数，默认 200]
+
+	每轮分两个阶段：
+	  1. 各线程只操作自己的键（键模线程数等于线程编号），但键在树中交错，结构修改依然互相穿插。
+	     结束后逐个核对树中的内容与各线程自己记录的结果。
+	  2. 所有线程争用同一小段键。结果不确定，只检查性质。
+	全部通过时返回 0，否则打印出错的轮次并返回 1.
+*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "ConcurrentRedBlackTree.hpp"
+
+namespace {
+
+	/**
+	 * 每个线程在阶段 1 中拥有的键数。
+	 */
+	const int OWNED_KEY_COUNT = 500;
+
+	/**
+	 * 阶段 2 中争用的键的范围。范围越小，越多地在根附近碰撞。
+	 */
+	const int CONTENDED_KEY_RANGE = 40;
+
+	const int OPERATIONS_PER_THREAD = 20000;
+
+	/**
+	 * 阶段 1：只操作自己的键，并记录期望的结果。
+	 */
+	void runOwnedKeys(
+		ConcurrentRedBlackTree<int, int>& tree,
+		int threadIndex,
+		int threadCount,
+		unsigned seed,
+		std::map<int, int>& expected
+	)
+	{
+		std::mt19937 random(seed);
+
+		for (int i = 0; i < OPERATIONS_PER_THREAD; i++) {
+			int key = int(random() % OWNED_KEY_COUNT) * threadCount + threadIndex;
+			unsigned operation = random() % 4;
+
+			if (operation < 2) {
+				tree.setData(key, i);
+				expected[key] = i;
+			}
+			else if (operation == 2) {
+				bool present = expected.erase(key) > 0;
+				try {
+					tree.removeKey(key);
+					if (!present) {
+						throw std::logic_error("removed a key that should not exist.");
+					}
+				}
+				catch (const std::runtime_error&) {
+					if (present) {
+						throw std::logic_error("failed to remove an existing key.");
+					}
+				}
+			}
+			else if (tree.hasKey(key) != (expected.count(key) > 0)) {
+				throw std::logic_error("hasKey disagrees with the expected content.");
+			}
+		}
+	}
+
+	/**
+	 * 阶段 2：争用同一小段键。
+	 */
+	void runContendedKeys(ConcurrentRedBlackTree<int, int>& tree, unsigned seed)
+	{
+		std::mt19937 random(seed);
+
+		for (int i = 0; i < OPERATIONS_PER_THREAD; i++) {
+			int key = int(random() % CONTENDED_KEY_RANGE);
+			unsigned operation = random() % 3;
+
+			if (operation == 0) {
+				tree.setData(key, i);
+			}
+			else if (operation == 1) {
+				try {
+					tree.removeKey(key);
+				}
+				catch (const std::runtime_error&) {
+					// 键可能已被其他线程删除。
+				}
+			}
+			else {
+				tree.hasKey(key);
+			}
+		}
+	}
+
+	/**
+	 * 运行一轮。
+	 *
+	 * @return 失败原因。通过时为 nullptr.
+	 */
+	const char* runRound(int threadCount, unsigned seed)
+	{
+		ConcurrentRedBlackTree<int, int> tree;
+		std::vector<std::map<int, int>> expected(threadCount);
+		std::vector<std::thread> threads;
+		std::vector<const char*> errors(threadCount, nullptr);
+
+		for (int t = 0; t < threadCount; t++) {
+			threads.emplace_back([&, t] {
+				try {
+					runOwnedKeys(tree, t, threadCount, seed * 131 + t, expected[t]);
+				}
+				catch (const std::logic_error&) {
+					errors[t] = "owned keys: an operation returned a wrong result.";
+				}
+			});
+		}
+		for (std::thread& thread : threads) {
+			thread.join();
+		}
+		threads.clear();
+
+		for (const char* error : errors) {
+			if (error != nullptr) {
+				return error;
+			}
+		}
+		if (!tree.checkInvariants()) {
+			return "owned keys: red black invariants violated.";
+		}
+		for (const std::map<int, int>& content : expected) {
+			for (const std::pair<const int, int>& element : content) {
+				if (!tree.hasKey(element.first) || tree.getData(element.first) != element.second) {
+					return "owned keys: content differs from the expected one.";
+				}
+			}
+		}
+
+		tree.clear();
+
+		for (int t = 0; t < threadCount; t++) {
+			threads.emplace_back([&, t] {
+				runContendedKeys(tree, seed * 137 + t);
+			});
+		}
+		for (std::thread& thread : threads) {
+			thread.join();
+		}
+
+		if (!tree.checkInvariants()) {
+			return "contended keys: red black invariants violated.";
+		}
+
+		return nullptr;
+	}
+
+}
+
+int main(int argc, char* argv[])
+{
+	int threadCount = argc > 1 ? std::atoi(argv[1]) : 8;
+	int roundCount = argc > 2 ? std::atoi(argv[2]) : 200;
+	if (threadCount <= 0 || roundCount <= 0) {
+		std::fprintf(stderr, "usage: %s [thread count] [round count]\n", argv[0]);
+		return 1;
+	}
+
+	std::printf("threads: %d, rounds: %d\n", threadCount, roundCount);
+
+	for (int round = 0; round < roundCount; round++) {
+		const char* error = runRound(threadCount, unsigned(round));
+		if (error != nullptr) {
+			std::printf("round %d failed: %s\n", round, error);
+			return 1;
+		}
+	}
+
+	std::printf("all rounds passed.\n");
+	return 0;
+}
@@ -0,0 +1,324 @@
+/**
+ * Durable Red Black Tree H
+ * by Flower Black
+ * 2022.1
+ * at Yushan County, Shangrao, Jiangxi
+ */
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+
+#include "RedBlackTree.hpp"
+
+/**
+ * 日志落盘策略。
+ */
+enum class DurableSyncPolicy {
+	/** 每次写操作独自写日志并 fdatasync，写者之间完全串行。 */
+	PER_WRITE,
+
+	/** 组提交：并发写者的日志合并成一批，由一个领导者统一 fdatasync。 */
+	GROUP_COMMIT,
+
+	/** 不主动 fdatasync，只在缓冲区满、sync() 或检查点时写入内核。崩溃时可能丢失最近的写入。 */
+	NONE
+};
+
+/**
+ * 持久化红黑树的配置。
+ */
+struct DurableRedBlackTreeOptions {
+	/** 日志落盘策略。 */
+	DurableSyncPolicy syncPolicy = DurableSyncPolicy::GROUP_COMMIT;
+
+	/** 组提交时，一批最多包含的日志记录数。达到该数目时领导者立即落盘。 */
+	size_t maxGroupSize = 128;
+
+	/**
+	 * 组提交时，领导者等待其他写者加入本批的最长时间。为 0 时不等待。
+	 * 只有在还有其他写者等待提交时才会等待，单个写者不受影响。
+	 */
+	std::chrono::microseconds groupWindow = std::chrono::microseconds(100);
+
+	/** NONE 策略下，缓冲日志超过该字节数时写入内核。 */
+	size_t unsyncedBufferLimit = 1 << 16;
+
+	/** 自上次检查点以来的日志记录数达到该值时，自动进行检查点。为 0 时不自动检查点。 */
+	size_t checkpointInterval = 1 << 20;
+};
+
+/**
+ * 带预写日志（write-ahead log）的红黑树。
+ *
+ * 每次 setData 和 removeKey 都先把操作追加到日志，日志按策略落盘后，才按日志的顺序应用到内存中的树，
+ * 然后返回。日志写入失败的操作不会出现在树中。启动时先加载最近一次检查点的快照，再重放其后的日志。
+ *
+ * 目录中的文件：
+ *   snapshot - 检查点快照。
+ *   wal      - 快照之后的操作日志。
+ *
+ * 本类的所有公开操作都是线程安全的。读操作只能看到日志已经落盘的数据（NONE 策略下为已追加的数据）。
+ */
+template <typename KeyType, typename DataType>
+class DurableRedBlackTree {
+
+public:
+	/** 树的生命相关操作。 */
+
+	/**
+	 * 打开（或创建）持久化的树，并从磁盘恢复数据。
+	 *
+	 * @param directory 存放快照与日志的目录。不存在时会被创建。
+	 * @param options 配置。
+	 * @exception runtime_error 文件读写失败或快照损坏时抛出。
+	 */
+	DurableRedBlackTree(
+		const std::string& directory,
+		const DurableRedBlackTreeOptions& options = DurableRedBlackTreeOptions()
+	);
+
+	/**
+	 * 将缓冲的日志落盘并关闭文件。
+	 */
+	~DurableRedBlackTree();
+
+	DurableRedBlackTree(const DurableRedBlackTree&) = delete;
+	DurableRedBlackTree& operator = (const DurableRedBlackTree&) = delete;
+
+public:
+	/** 树的基本查询操作。 */
+
+	/**
+	 * 判断键是否在树里。
+	 *
+	 * @param queryKey 待判断的键。
+	 * @return 是否在树上找到了对应键。
+	 */
+	bool hasKey(const KeyType& queryKey);
+
+	/**
+	 * 根据键获取数据。由于其他线程可能同时修改树，返回的是数据的拷贝。
+	 *
+	 * @param key 键。
+	 * @return 键对应的数据。
+	 * @exception runtime_error 如果无法找到键，会抛出异常。
+	 */
+	DataType getData(const KeyType& key);
+
+	/**
+	 * 设置数据。如果键已经存在，会更新原有数据。日志按策略落盘后才返回。
+	 * 写入后若触发自动检查点，检查点失败不会使本次写入失败，留待之后重试。
+	 *
+	 * @param key 键。
+	 * @param data 数据。
+	 * @exception runtime_error 日志写入失败时抛出。此时树不会被修改。
+	 */
+	DurableRedBlackTree<KeyType, DataType>& setData(const KeyType& key, const DataType& data);
+
+	/**
+	 * 删除键。日志按策略落盘后才返回。自动检查点的处理与 setData 相同。
+	 *
+	 * @param key 键。
+	 * @return 持久化红黑树对象自身。
+	 * @exception runtime_error 找不到键或日志写入失败时抛出。此时树不会被修改。
+	 */
+	DurableRedBlackTree<KeyType, DataType>& removeKey(const KeyType& key);
+
+public:
+	/** 持久化相关操作。 */
+
+	/**
+	 * 将所有已追加的日志落盘。NONE 策略下可用于手动设置持久点。
+	 *
+	 * @exception runtime_error 日志写入失败时抛出。
+	 */
+	void sync();
+
+	/**
+	 * 进行检查点：将整棵树写入新快照，并清空日志。
+	 * 检查点期间会阻塞所有写者。
+	 *
+	 * @exception runtime_error 文件读写失败时抛出。
+	 */
+	void checkpoint();
+
+private:
+	enum class LogOperation : uint8_t {
+		SET_DATA = 1, REMOVE_KEY = 2
+	};
+
+	/**
+	 * 快照文件的魔数："RBTSNAP1".
+	 */
+	static constexpr uint64_t SNAPSHOT_MAGIC = 0x3150414e53544252ULL;
+
+	/**
+	 * 日志记录头：记录体长度与校验和。
+	 */
+	static constexpr size_t RECORD_HEADER_SIZE = sizeof(uint32_t) * 2;
+
+	/**
+	 * 已追加到日志、尚未应用到树的操作。
+	 */
+	struct PendingOperation {
+		uint64_t logSequenceNumber;
+		LogOperation operation;
+		KeyType key;
+		DataType data;
+	};
+
+private:
+	/**
+	 * 加载快照，再重放日志。日志末尾不完整的记录会被截掉。
+	 */
+	void recover();
+
+	/**
+	 * 将一条记录追加到待落盘缓冲区，并把操作排入待应用队列。调用者需持有 mutex.
+	 *
+	 * @param operation 操作类型。
+	 * @param key 键。
+	 * @param data 数据。删除操作时为 nullptr.
+	 * @return 该记录的日志序号。
+	 */
+	uint64_t appendRecord(LogOperation operation, const KeyType& key, const DataType* data);
+
+	/**
+	 * 按日志顺序把序号不超过 logSequenceNumber 的待应用操作应用到树上。调用者需持有 mutex.
+	 */
+	void applyOperations(uint64_t logSequenceNumber);
+
+	/**
+	 * 键在应用完所有待应用操作后是否存在。调用者需持有 mutex.
+	 */
+	bool hasKeyAfterPendingOperations(const KeyType& key);
+
+	/**
+	 * 写操作提交后的自动检查点。检查点失败时不抛出异常，推迟到再积累 checkpointInterval 条记录后重试。
+	 * 调用者需持有 mutex.
+	 *
+	 * @param lock 已锁住 mutex 的锁。
+	 */
+	void checkpointIfNeeded(std::unique_lock<std::mutex>& lock);
+
+	/**
+	 * 等待某条记录落盘。必要时由当前线程担任领导者，执行一次组提交。
+	 *
+	 * @param logSequenceNumber 记录的日志序号。
+	 * @param lock 已锁住 mutex 的锁。等待期间可能被暂时释放。
+	 */
+	void commit(uint64_t logSequenceNumber, std::unique_lock<std::mutex>& lock);
+
+	/**
+	 * 写出所有缓冲日志，并按需落盘。落盘后应用所有待应用的操作。
+	 * 调用者需持有 mutex，且当前没有进行中的组提交。
+	 *
+	 * @param durable 是否需要 fdatasync.
+	 */
+	void flushPendingLog(bool durable);
+
+	/**
+	 * 检查点的实现。先把缓冲日志落盘，使树包含所有已追加的操作。调用者需持有 mutex.
+	 *
+	 * @param lock 已锁住 mutex 的锁。
+	 */
+	void checkpointLocked(std::unique_lock<std::mutex>& lock);
+
+	/**
+	 * 计算校验和（FNV-1a）。
+	 */
+	static uint32_t checksum(const char* buffer, size_t length);
+
+	/**
+	 * 将缓冲区完整写入文件。
+	 *
+	 * @exception runtime_error 写入失败时抛出。
+	 */
+	static void writeFully(int fileDescriptor, const char* buffer, size_t length);
+
+	/**
+	 * 读取整个文件。文件不存在时返回 false.
+	 *
+	 * @exception runtime_error 读取失败时抛出。
+	 */
+	static bool readWholeFile(const std::string& path, std::string& content);
+
+private:
+	/**
+	 * 内存中的树。
+	 */
+	RedBlackTree<KeyType, DataType> tree;
+
+	DurableRedBlackTreeOptions options;
+
+	std::string directory;
+	std::string logPath;
+	std::string snapshotPath;
+
+	/**
+	 * 日志文件。以追加方式打开。
+	 */
+	int logFileDescriptor = -1;
+
+	/**
+	 * 保护树与以下所有状态。
+	 */
+	std::mutex mutex;
+
+	/**
+	 * 组提交完成时通知等待的写者。
+	 */
+	std::condition_variable durableCondition;
+
+	/**
+	 * 领导者收集一批日志时，用于等待后来的写者加入。
+	 */
+	std::condition_variable groupCondition;
+
+	/**
+	 * 已追加、尚未写入文件的日志。
+	 */
+	std::string pendingLog;
+
+	/**
+	 * 已追加、尚未应用到树的操作，按日志序号排列。
+	 */
+	std::deque<PendingOperation> pendingOperations;
+
+	/**
+	 * 正在组提交中等待自己的记录落盘的写者数（包括领导者）。
+	 */
+	size_t committingWriterCount = 0;
+
+	/**
+	 * 最后一条追加的记录的序号。
+	 */
+	uint64_t appendedSequenceNumber = 0;
+
+	/**
+	 * 已落盘的最大记录序号。
+	 */
+	uint64_t durableSequenceNumber = 0;
+
+	/**
+	 * 是否有领导者正在执行组提交。
+	 */
+	bool flushInProgress = false;
+
+	/**
+	 * 日志曾经写入失败。此后无法保证持久性，所有写操作都会失败。
+	 */
+	bool logBroken = false;
+
+	/**
+	 * 自上次检查点以来的日志记录数。
+	 */
+	size_t recordsSinceCheckpoint = 0;
+
+};
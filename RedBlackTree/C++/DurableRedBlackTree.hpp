@@ -0,0 +1,590 @@
+/**
+ * Durable Red Black Tree Hpp
+ * by Flower Black
+ * 2022.1
+ * at Yushan County, Shangrao, Jiangxi
+ */
+
+#pragma once
+
+#include <cerrno>
+#include <cstring>
+#include <exception>
+#include <stdexcept>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "DurableRedBlackTree.h"
+#include "RedBlackTreeSerializer.hpp"
+
+template<typename KeyType, typename DataType>
+DurableRedBlackTree<KeyType, DataType>::DurableRedBlackTree(
+	const std::string& directory,
+	const DurableRedBlackTreeOptions& options
+) : options(options), directory(directory)
+{
+	this->logPath = directory + "/wal";
+	this->snapshotPath = directory + "/snapshot";
+	this->recover();
+}
+
+template<typename KeyType, typename DataType>
+DurableRedBlackTree<KeyType, DataType>::~DurableRedBlackTree()
+{
+	std::unique_lock<std::mutex> lock(this->mutex);
+	this->durableCondition.wait(lock, [this] { return !this->flushInProgress; });
+
+	try {
+		if (!this->logBroken) {
+			this->flushPendingLog(true);
+		}
+	}
+	catch (...) {
+		// 析构函数不能抛出异常。未能落盘的日志只能放弃。
+	}
+
+	if (this->logFileDescriptor >= 0) {
+		close(this->logFileDescriptor);
+		this->logFileDescriptor = -1;
+	}
+}
+
+template<typename KeyType, typename DataType>
+bool DurableRedBlackTree<KeyType, DataType>::hasKey(const KeyType& queryKey)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	return this->tree.hasKey(queryKey);
+}
+
+template<typename KeyType, typename DataType>
+DataType DurableRedBlackTree<KeyType, DataType>::getData(const KeyType& key)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	return this->tree.getData(key);
+}
+
+template<typename KeyType, typename DataType>
+DurableRedBlackTree<KeyType, DataType>& DurableRedBlackTree<KeyType, DataType>::setData(
+	const KeyType& key,
+	const DataType& data
+)
+{
+	std::unique_lock<std::mutex> lock(this->mutex);
+	if (this->logBroken) {
+		throw std::runtime_error("the write-ahead log is broken.");
+	}
+
+	// 先写日志，落盘后再应用到树（由 commit 负责）。
+	uint64_t logSequenceNumber = this->appendRecord(LogOperation::SET_DATA, key, &data);
+	this->commit(logSequenceNumber, lock);
+	this->checkpointIfNeeded(lock);
+
+	return *this;
+}
+
+template<typename KeyType, typename DataType>
+DurableRedBlackTree<KeyType, DataType>& DurableRedBlackTree<KeyType, DataType>::removeKey(
+	const KeyType& key
+)
+{
+	std::unique_lock<std::mutex> lock(this->mutex);
+	if (this->logBroken) {
+		throw std::runtime_error("the write-ahead log is broken.");
+	}
+
+	// 找不到键时不写日志。前面的写者的操作可能还没有应用到树上，需要一并考虑。
+	if (!this->hasKeyAfterPendingOperations(key)) {
+		throw std::runtime_error("key not found.");
+	}
+
+	uint64_t logSequenceNumber = this->appendRecord(LogOperation::REMOVE_KEY, key, nullptr);
+	this->commit(logSequenceNumber, lock);
+	this->checkpointIfNeeded(lock);
+
+	return *this;
+}
+
+template<typename KeyType, typename DataType>
+void DurableRedBlackTree<KeyType, DataType>::sync()
+{
+	std::unique_lock<std::mutex> lock(this->mutex);
+	this->durableCondition.wait(lock, [this] { return !this->flushInProgress; });
+	this->flushPendingLog(true);
+}
+
+template<typename KeyType, typename DataType>
+void DurableRedBlackTree<KeyType, DataType>::checkpoint()
+{
+	std::unique_lock<std::mutex> lock(this->mutex);
+	this->checkpointLocked(lock);
+}
+
+template<typename KeyType, typename DataType>
+void DurableRedBlackTree<KeyType, DataType>::recover()
+{
+	if (mkdir(this->directory.c_str(), 0755) != 0 && errno != EEXIST) {
+		throw std::runtime_error(
+			"failed to create directory " + this->directory + ": " + std::strerror(errno)
+		);
+	}
+
+	// 加载快照。
+	std::string content;
+	if (readWholeFile(this->snapshotPath, content)) {
+		// 快照通过“写临时文件再改名”的方式生成，因此不会是半个文件。校验失败说明文件已损坏。
+		const size_t headerSize = sizeof(uint64_t) * 2;
+		if (content.size() < headerSize + sizeof(uint32_t)) {
+			throw std::runtime_error("snapshot " + this->snapshotPath + " is corrupted.");
+		}
+
+		size_t bodyLength = content.size() - sizeof(uint32_t);
+		uint32_t storedChecksum;
+		std::memcpy(&storedChecksum, content.data() + bodyLength, sizeof(storedChecksum));
+
+		uint64_t magic;
+		uint64_t count;
+		std::memcpy(&magic, content.data(), sizeof(magic));
+		std::memcpy(&count, content.data() + sizeof(magic), sizeof(count));
+		if (magic != SNAPSHOT_MAGIC
+			|| storedChecksum != checksum(content.data(), bodyLength))
+		{
+			throw std::runtime_error("snapshot " + this->snapshotPath + " is corrupted.");
+		}
+
+		const char* cursor = content.data() + headerSize;
+		const char* end = content.data() + bodyLength;
+		for (uint64_t i = 0; i < count; i++) {
+			KeyType key;
+			DataType data;
+			if (!RedBlackTreeSerializer<KeyType>::read(cursor, end, key)
+				|| !RedBlackTreeSerializer<DataType>::read(cursor, end, data))
+			{
+				throw std::runtime_error("snapshot " + this->snapshotPath + " is corrupted.");
+			}
+			this->tree.setData(key, data);
+		}
+	}
+
+	// 上次检查点可能在改名前中断，留下临时文件。
+	unlink((this->snapshotPath + ".tmp").c_str());
+
+	// 重放日志。遇到不完整或校验失败的记录时停止，它及之后的内容都视为未提交。
+	// 崩溃若发生在快照改名之后、清空日志之前，日志中的操作会被重放到已包含它们的快照上。
+	// 由于同一个键的最终状态只取决于它的最后一次操作，重放的结果不变。
+	size_t validLength = 0;
+	content.clear();
+	readWholeFile(this->logPath, content);
+
+	const char* cursor = content.data();
+	const char* end = content.data() + content.size();
+	while (static_cast<size_t>(end - cursor) >= RECORD_HEADER_SIZE) {
+		uint32_t bodyLength;
+		uint32_t storedChecksum;
+		std::memcpy(&bodyLength, cursor, sizeof(bodyLength));
+		std::memcpy(&storedChecksum, cursor + sizeof(bodyLength), sizeof(storedChecksum));
+
+		const char* body = cursor + RECORD_HEADER_SIZE;
+		if (static_cast<size_t>(end - body) < bodyLength
+			|| checksum(body, bodyLength) != storedChecksum)
+		{
+			break; // 记录不完整或已损坏。
+		}
+
+		const char* bodyCursor = body;
+		const char* bodyEnd = body + bodyLength;
+		if (bodyLength < 1) {
+			break;
+		}
+		LogOperation operation = static_cast<LogOperation>(*bodyCursor);
+		bodyCursor++;
+
+		KeyType key;
+		if (!RedBlackTreeSerializer<KeyType>::read(bodyCursor, bodyEnd, key)) {
+			break;
+		}
+
+		if (operation == LogOperation::SET_DATA) {
+			DataType data;
+			if (!RedBlackTreeSerializer<DataType>::read(bodyCursor, bodyEnd, data)) {
+				break;
+			}
+			this->tree.setData(key, data);
+		}
+		else if (operation == LogOperation::REMOVE_KEY) {
+			if (this->tree.hasKey(key)) {
+				this->tree.removeKey(key);
+			}
+		}
+		else {
+			break; // 未知的操作。
+		}
+
+		cursor = bodyEnd;
+		validLength = cursor - content.data();
+		this->recordsSinceCheckpoint++;
+	}
+
+	this->logFileDescriptor = open(
+		this->logPath.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644
+	);
+	if (this->logFileDescriptor < 0) {
+		throw std::runtime_error("failed to open " + this->logPath + ": " + std::strerror(errno));
+	}
+
+	// 截掉末尾未提交的部分，避免新记录接在损坏的记录后面。
+	if (validLength < content.size()) {
+		if (ftruncate(this->logFileDescriptor, validLength) != 0
+			|| fdatasync(this->logFileDescriptor) != 0)
+		{
+			throw std::runtime_error(
+				"failed to truncate " + this->logPath + ": " + std::strerror(errno)
+			);
+		}
+	}
+}
+
+template<typename KeyType, typename DataType>
+uint64_t DurableRedBlackTree<KeyType, DataType>::appendRecord(
+	LogOperation operation,
+	const KeyType& key,
+	const DataType* data
+)
+{
+	// 先占住记录头的位置，写完记录体后再回填。
+	size_t headerPosition = this->pendingLog.size();
+	this->pendingLog.append(RECORD_HEADER_SIZE, '\0');
+
+	this->pendingLog.push_back(static_cast<char>(operation));
+	RedBlackTreeSerializer<KeyType>::write(this->pendingLog, key);
+	if (data != nullptr) {
+		RedBlackTreeSerializer<DataType>::write(this->pendingLog, *data);
+	}
+
+	size_t bodyPosition = headerPosition + RECORD_HEADER_SIZE;
+	uint32_t bodyLength = static_cast<uint32_t>(this->pendingLog.size() - bodyPosition);
+	uint32_t bodyChecksum = checksum(this->pendingLog.data() + bodyPosition, bodyLength);
+	std::memcpy(&this->pendingLog[headerPosition], &bodyLength, sizeof(bodyLength));
+	std::memcpy(
+		&this->pendingLog[headerPosition + sizeof(bodyLength)], &bodyChecksum, sizeof(bodyChecksum)
+	);
+
+	this->recordsSinceCheckpoint++;
+	this->appendedSequenceNumber++;
+
+	this->pendingOperations.push_back(PendingOperation {
+		this->appendedSequenceNumber, operation, key, data != nullptr ? *data : DataType()
+	});
+	return this->appendedSequenceNumber;
+}
+
+template<typename KeyType, typename DataType>
+void DurableRedBlackTree<KeyType, DataType>::applyOperations(uint64_t logSequenceNumber)
+{
+	while (!this->pendingOperations.empty()
+		&& this->pendingOperations.front().logSequenceNumber <= logSequenceNumber)
+	{
+		PendingOperation& pending = this->pendingOperations.front();
+		if (pending.operation == LogOperation::SET_DATA) {
+			this->tree.upsert(pending.key, [&pending](DataType& data) {
+				data = std::move(pending.data);
+			});
+		}
+		else if (this->tree.hasKey(pending.key)) {
+			this->tree.removeKey(pending.key);
+		}
+		this->pendingOperations.pop_front();
+	}
+}
+
+template<typename KeyType, typename DataType>
+bool DurableRedBlackTree<KeyType, DataType>::hasKeyAfterPendingOperations(const KeyType& key)
+{
+	// 同一个键以最后一次操作为准。待应用的操作不会超过一两批，从后往前找即可。
+	for (auto it = this->pendingOperations.rbegin(); it != this->pendingOperations.rend(); ++it) {
+		if (it->key == key) {
+			return it->operation == LogOperation::SET_DATA;
+		}
+	}
+	return this->tree.hasKey(key);
+}
+
+template<typename KeyType, typename DataType>
+void DurableRedBlackTree<KeyType, DataType>::checkpointIfNeeded(std::unique_lock<std::mutex>& lock)
+{
+	if (this->options.checkpointInterval == 0
+		|| this->recordsSinceCheckpoint < this->options.checkpointInterval)
+	{
+		return;
+	}
+
+	try {
+		this->checkpointLocked(lock);
+	}
+	catch (...) {
+		// 本次写入已经提交，不能因为检查点失败（包括生成快照时内存不足、拷贝键或数据失败）而报告写入失败。
+		// 快照失败时日志仍然完整，可以稍后重试；清空日志失败时 logBroken 已被设置，之后的写入会报错。
+		this->recordsSinceCheckpoint = 0;
+	}
+}
+
+template<typename KeyType, typename DataType>
+void DurableRedBlackTree<KeyType, DataType>::commit(
+	uint64_t logSequenceNumber,
+	std::unique_lock<std::mutex>& lock
+)
+{
+	if (this->options.syncPolicy == DurableSyncPolicy::NONE) {
+		// 只在缓冲区积累到一定大小时写入内核，不等待落盘。
+		if (this->pendingLog.size() >= this->options.unsyncedBufferLimit && !this->flushInProgress) {
+			this->flushPendingLog(false);
+		}
+		this->applyOperations(logSequenceNumber);
+		return;
+	}
+
+	if (this->options.syncPolicy == DurableSyncPolicy::PER_WRITE) {
+		// 持有锁写日志并落盘，写者之间完全串行。
+		this->flushPendingLog(true);
+		return;
+	}
+
+	// 组提交。
+	// 第一个发现没有进行中的提交的写者成为领导者，负责把缓冲区中的所有记录一起落盘；
+	// 其他写者等待领导者完成。领导者落盘期间追加的记录会由下一个领导者处理。
+	// 落盘后由领导者在持有锁时按日志顺序应用整批操作，因此同一个键的多次写入不会乱序。
+	this->groupCondition.notify_one(); // 通知正在收集的领导者：有新的记录加入。
+	this->committingWriterCount++;
+
+	while (this->durableSequenceNumber < logSequenceNumber) {
+		if (this->logBroken) {
+			this->committingWriterCount--;
+			throw std::runtime_error("the write-ahead log is broken.");
+		}
+
+		if (this->flushInProgress) {
+			this->durableCondition.wait(lock);
+			continue;
+		}
+
+		// 成为领导者。
+		this->flushInProgress = true;
+
+		if (this->options.groupWindow.count() > 0 && this->committingWriterCount > 1) {
+			// 还有其他写者在等待提交，说明写入是并发的。
+			// 等待更多写者加入本批，直到本批已满或超时。只有一个写者时等待只会白白增加延迟。
+			this->groupCondition.wait_for(lock, this->options.groupWindow, [this] {
+				return this->appendedSequenceNumber - this->durableSequenceNumber
+					>= this->options.maxGroupSize;
+			});
+		}
+
+		std::string batch;
+		batch.swap(this->pendingLog);
+		uint64_t batchSequenceNumber = this->appendedSequenceNumber;
+
+		// 落盘期间释放锁，让其他写者可以继续追加下一批记录。
+		lock.unlock();
+		std::exception_ptr failure;
+		try {
+			writeFully(this->logFileDescriptor, batch.data(), batch.size());
+			if (fdatasync(this->logFileDescriptor) != 0) {
+				throw std::runtime_error(
+					"failed to sync " + this->logPath + ": " + std::strerror(errno)
+				);
+			}
+		}
+		catch (...) {
+			failure = std::current_exception();
+		}
+		lock.lock();
+
+		this->flushInProgress = false;
+		if (failure) {
+			this->logBroken = true;
+		}
+		else if (batchSequenceNumber > this->durableSequenceNumber) {
+			this->durableSequenceNumber = batchSequenceNumber;
+			this->applyOperations(batchSequenceNumber);
+		}
+		this->durableCondition.notify_all();
+
+		if (failure) {
+			this->committingWriterCount--;
+			std::rethrow_exception(failure);
+		}
+	}
+
+	this->committingWriterCount--;
+}
+
+template<typename KeyType, typename DataType>
+void DurableRedBlackTree<KeyType, DataType>::flushPendingLog(bool durable)
+{
+	if (this->logBroken) {
+		throw std::runtime_error("the write-ahead log is broken.");
+	}
+
+	try {
+		writeFully(this->logFileDescriptor, this->pendingLog.data(), this->pendingLog.size());
+		this->pendingLog.clear();
+
+		if (durable) {
+			if (fdatasync(this->logFileDescriptor) != 0) {
+				throw std::runtime_error(
+					"failed to sync " + this->logPath + ": " + std::strerror(errno)
+				);
+			}
+			this->durableSequenceNumber = this->appendedSequenceNumber;
+			this->applyOperations(this->durableSequenceNumber);
+			this->durableCondition.notify_all();
+		}
+	}
+	catch (...) {
+		this->logBroken = true;
+		this->durableCondition.notify_all();
+		throw;
+	}
+}
+
+template<typename KeyType, typename DataType>
+void DurableRedBlackTree<KeyType, DataType>::checkpointLocked(std::unique_lock<std::mutex>& lock)
+{
+	// 等待进行中的组提交结束。之后一直持有锁，写者无法追加新记录。
+	this->durableCondition.wait(lock, [this] { return !this->flushInProgress; });
+
+	// 还在等待下一批组提交的记录先落盘并应用到树上，快照才包含所有已追加的操作。
+	if (!this->pendingLog.empty() || this->durableSequenceNumber < this->appendedSequenceNumber) {
+		this->flushPendingLog(true);
+	}
+
+	// 生成快照：魔数，元素个数，各个元素，校验和。
+	std::string snapshot;
+	uint64_t count = 0;
+	uint64_t magic = SNAPSHOT_MAGIC;
+	snapshot.append(reinterpret_cast<const char*>(&magic), sizeof(magic));
+	snapshot.append(sizeof(count), '\0');
+	this->tree.forEach([&snapshot, &count](const KeyType& key, DataType& data) {
+		RedBlackTreeSerializer<KeyType>::write(snapshot, key);
+		RedBlackTreeSerializer<DataType>::write(snapshot, data);
+		count++;
+	});
+	std::memcpy(&snapshot[sizeof(uint64_t)], &count, sizeof(count));
+	uint32_t snapshotChecksum = checksum(snapshot.data(), snapshot.size());
+	snapshot.append(reinterpret_cast<const char*>(&snapshotChecksum), sizeof(snapshotChecksum));
+
+	// 先写临时文件并落盘，再改名覆盖旧快照。改名是原子的。
+	std::string temporaryPath = this->snapshotPath + ".tmp";
+	int snapshotFileDescriptor = open(
+		temporaryPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644
+	);
+	if (snapshotFileDescriptor < 0) {
+		throw std::runtime_error("failed to open " + temporaryPath + ": " + std::strerror(errno));
+	}
+
+	try {
+		writeFully(snapshotFileDescriptor, snapshot.data(), snapshot.size());
+		if (fsync(snapshotFileDescriptor) != 0) {
+			throw std::runtime_error("failed to sync " + temporaryPath + ": " + std::strerror(errno));
+		}
+	}
+	catch (...) {
+		close(snapshotFileDescriptor);
+		unlink(temporaryPath.c_str()); // 不留下写了一半的临时文件。
+		throw;
+	}
+	close(snapshotFileDescriptor);
+
+	if (rename(temporaryPath.c_str(), this->snapshotPath.c_str()) != 0) {
+		std::string reason = std::strerror(errno);
+		unlink(temporaryPath.c_str());
+		throw std::runtime_error("failed to rename " + temporaryPath + ": " + reason);
+	}
+
+	// 让改名本身也落盘。
+	int directoryFileDescriptor = open(this->directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (directoryFileDescriptor >= 0) {
+		fsync(directoryFileDescriptor);
+		close(directoryFileDescriptor);
+	}
+
+	// 快照已包含所有操作，日志可以清空了。
+	if (ftruncate(this->logFileDescriptor, 0) != 0 || fdatasync(this->logFileDescriptor) != 0) {
+		this->logBroken = true;
+		throw std::runtime_error("failed to truncate " + this->logPath + ": " + std::strerror(errno));
+	}
+
+	this->pendingLog.clear();
+	this->durableSequenceNumber = this->appendedSequenceNumber;
+	this->recordsSinceCheckpoint = 0;
+	this->durableCondition.notify_all();
+}
+
+template<typename KeyType, typename DataType>
+uint32_t DurableRedBlackTree<KeyType, DataType>::checksum(const char* buffer, size_t length)
+{
+	uint32_t hash = 2166136261u;
+	for (size_t i = 0; i < length; i++) {
+		hash ^= static_cast<unsigned char>(buffer[i]);
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+template<typename KeyType, typename DataType>
+void DurableRedBlackTree<KeyType, DataType>::writeFully(
+	int fileDescriptor,
+	const char* buffer,
+	size_t length
+)
+{
+	while (length > 0) {
+		ssize_t written = write(fileDescriptor, buffer, length);
+		if (written < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			throw std::runtime_error(std::string("failed to write log: ") + std::strerror(errno));
+		}
+		buffer += written;
+		length -= static_cast<size_t>(written);
+	}
+}
+
+template<typename KeyType, typename DataType>
+bool DurableRedBlackTree<KeyType, DataType>::readWholeFile(
+	const std::string& path,
+	std::string& content
+)
+{
+	int fileDescriptor = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fileDescriptor < 0) {
+		if (errno == ENOENT) {
+			return false;
+		}
+		throw std::runtime_error("failed to open " + path + ": " + std::strerror(errno));
+	}
+
+	char buffer[1 << 16];
+	while (true) {
+		ssize_t bytesRead = read(fileDescriptor, buffer, sizeof(buffer));
+		if (bytesRead < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			int error = errno;
+			close(fileDescriptor);
+			throw std::runtime_error("failed to read " + path + ": " + std::strerror(error));
+		}
+		if (bytesRead == 0) {
+			break;
+		}
+		content.append(buffer, static_cast<size_t>(bytesRead));
+	}
+
+	close(fileDescriptor);
+	return true;
+}
@@ -0,0 +1,273 @@
+/**
+ * Paged Red Black Tree H
+ * by Flower Black
+ * 2022.1
+ * at Yushan County, Shangrao, Jiangxi
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <string>
+
+#include "RedBlackTree.hpp"
+
+/**
+ * 分页红黑树的配置。
+ */
+struct PagedRedBlackTreeOptions {
+	/** 常驻内存的节点数上限。超过时换出最久未访问的页。当前正在访问的页总是常驻。 */
+	size_t residentNodeBudget = 1 << 20;
+
+	/** 每页最多的节点数。页满时对半分裂。 */
+	size_t pageNodeCount = 4096;
+};
+
+/**
+ * 可以把冷数据换出到磁盘的红黑树，用于数据量超过内存、但访问集中在少量热键上的场景。
+ *
+ * 键空间被划分成若干连续的页，每页是一棵独立的红黑树（冷子树）。
+ * 页目录也是一棵红黑树，以每页的最大键为键。页被换出时，它的树序列化到交换文件后释放，
+ * 目录中只剩一个桩：记录节点数和文件中的位置。访问落到桩上时，透明地读回整页（缺页）。
+ * 常驻的页按最近访问的顺序排成链表，常驻节点数超过预算时从最久未访问的一端换出。
+ *
+ * 未被修改过的页换出时不需要写盘。
+ * 交换文件只是临时空间：打开后立即删除目录项，树析构（或进程退出）时空间自动回收。
+ *
+ * 键与数据通过 RedBlackTreeSerializer 序列化。本类不是线程安全的。
+ */
+template <typename KeyType, typename DataType>
+class PagedRedBlackTree {
+
+public:
+	/** 树的生命相关操作。 */
+
+	/**
+	 * 创建空的分页红黑树。
+	 *
+	 * @param swapPath 交换文件的路径。已存在的文件会被覆盖。
+	 * @param options 配置。
+	 * @exception runtime_error 无法创建交换文件，或配置不合法时抛出。
+	 */
+	PagedRedBlackTree(
+		const std::string& swapPath,
+		const PagedRedBlackTreeOptions& options = PagedRedBlackTreeOptions()
+	);
+
+	/**
+	 * 释放所有页，关闭交换文件。
+	 */
+	~PagedRedBlackTree();
+
+	PagedRedBlackTree(const PagedRedBlackTree&) = delete;
+	PagedRedBlackTree& operator = (const PagedRedBlackTree&) = delete;
+
+public:
+	/** 树的基本查询操作。 */
+
+	/**
+	 * 判断键是否在树里。可能引起缺页。
+	 *
+	 * @param queryKey 待判断的键。
+	 * @return 是否在树上找到了对应键。
+	 */
+	bool hasKey(const KeyType& queryKey);
+
+	/**
+	 * 根据键获取数据。页随时可能被换出，因此返回的是数据的拷贝。
+	 *
+	 * @param key 键。
+	 * @return 键对应的数据。
+	 * @exception runtime_error 如果无法找到键，或缺页时读取失败，会抛出异常。
+	 */
+	DataType getData(const KeyType& key);
+
+	/**
+	 * 设置数据。如果键已经存在，会更新原有数据。
+	 *
+	 * @param key 键。
+	 * @param data 数据。
+	 * @return 分页红黑树对象自身。
+	 * 插入之后若常驻节点数超过预算，会换出其他页；此时的换出失败不会抛出异常，
+	 * 因为数据已经写入，被换出的页保持常驻，常驻节点数暂时超出预算，留待下次换出时重试。
+	 *
+	 * @exception runtime_error 插入之前缺页或换出时读写失败会抛出异常。此时树不会被修改。
+	 */
+	PagedRedBlackTree<KeyType, DataType>& setData(const KeyType& key, const DataType& data);
+
+	/**
+	 * 删除键。
+	 *
+	 * @param key 键。
+	 * @return 分页红黑树对象自身。
+	 * @exception runtime_error 找不到键，或缺页时读取失败，会抛出异常。
+	 */
+	PagedRedBlackTree<KeyType, DataType>& removeKey(const KeyType& key);
+
+	/**
+	 * 判断树是否为空。
+	 */
+	bool isEmpty() const;
+
+	/**
+	 * 按键从小到大的顺序访问每个元素。逐页读入，遍历过程中照常按预算换出。
+	 * 访问函数可以修改数据，因此访问过的页都视为已修改；只读时应使用 forEachReadOnly. 遍历过程中不可修改树的结构。
+	 *
+	 * @param function 访问函数，形如 void(const KeyType& key, DataType& data)。
+	 */
+	template <typename Function>
+	void forEach(Function&& function);
+
+	/**
+	 * 只读地按键从小到大的顺序访问每个元素。与 forEach 相同，但不会把访问过的页标记为已修改，
+	 * 换出这些页时不必重新写入交换文件。
+	 *
+	 * @param function 访问函数，形如 void(const KeyType& key, const DataType& data)。
+	 */
+	template <typename Function>
+	void forEachReadOnly(Function&& function);
+
+public:
+	/** 统计信息。 */
+
+	/**
+	 * 树中的节点总数（包括已换出的）。
+	 */
+	size_t getNodeCount() const;
+
+	/**
+	 * 当前常驻内存的节点数。
+	 */
+	size_t getResidentNodeCount() const;
+
+	/**
+	 * 缺页（从交换文件读回一页）的次数。
+	 */
+	size_t getPageFaultCount() const;
+
+	/**
+	 * 换出一页的次数。
+	 */
+	size_t getEvictionCount() const;
+
+private:
+	/**
+	 * 一页：键空间中连续的一段。
+	 */
+	struct Page {
+		/** 常驻时页中的元素。换出后为空。 */
+		RedBlackTree<KeyType, DataType> tree;
+
+		/** 页中的节点数。换出后仍然有效。 */
+		size_t nodeCount = 0;
+
+		bool resident = true;
+
+		/** 自上次写入交换文件以来是否被修改过。 */
+		bool dirty = true;
+
+		/** 在交换文件中的位置。slotCapacity 为 0 表示还没有分配空间。 */
+		uint64_t slotOffset = 0;
+		uint64_t slotLength = 0;
+		uint64_t slotCapacity = 0;
+
+		/** 在最近访问链表中的位置。仅常驻时有效。 */
+		typename std::list<Page*>::iterator recentPosition;
+	};
+
+	using DirectoryHandle = typename RedBlackTree<KeyType, Page*>::Handle;
+
+private:
+	/**
+	 * 确保页常驻，并标记为最近访问。必要时换出其他页。
+	 */
+	void touch(Page* page);
+
+	/**
+	 * 从交换文件读回一页。
+	 *
+	 * @exception runtime_error 读取失败或数据损坏时抛出。
+	 */
+	void loadPage(Page* page);
+
+	/**
+	 * 换出一页：必要时写入交换文件，然后释放页中的树。
+	 *
+	 * @exception runtime_error 写入失败时抛出。此时页保持常驻。
+	 */
+	void evictPage(Page* page);
+
+	/**
+	 * 常驻节点数超过预算时，从最久未访问的一端换出，但不换出 keep.
+	 */
+	void evictOverBudget(Page* keep);
+
+	/**
+	 * 把满了的页对半分裂。较小的一半移到新页中。
+	 */
+	void splitPage(Page* page);
+
+	/**
+	 * 从目录和最近访问链表中移除一页，回收它在交换文件中的空间，并释放它。
+	 */
+	void destroyPage(const KeyType& pageKey, Page* page);
+
+	/**
+	 * 在交换文件中为一页分配空间。优先复用不小于 length 的空闲空间。
+	 */
+	void allocateSlot(Page* page, uint64_t length);
+
+	/**
+	 * 回收一页在交换文件中的空间。
+	 */
+	void releaseSlot(Page* page);
+
+	/**
+	 * 在指定位置完整写入缓冲区。
+	 *
+	 * @exception runtime_error 写入失败时抛出。
+	 */
+	void writeAt(const char* buffer, size_t length, uint64_t offset);
+
+	/**
+	 * 在指定位置完整读出缓冲区。
+	 *
+	 * @exception runtime_error 读取失败时抛出。
+	 */
+	void readAt(char* buffer, size_t length, uint64_t offset);
+
+private:
+	PagedRedBlackTreeOptions options;
+
+	std::string swapPath;
+	int swapFileDescriptor = -1;
+
+	/**
+	 * 交换文件的末尾。新的空间从这里分配。
+	 */
+	uint64_t swapFileSize = 0;
+
+	/**
+	 * 交换文件中的空闲空间：容量 -> 位置。
+	 */
+	std::multimap<uint64_t, uint64_t> freeSlots;
+
+	/**
+	 * 页目录：每页的最大键 -> 页。
+	 */
+	RedBlackTree<KeyType, Page*> directory;
+
+	/**
+	 * 常驻的页，最近访问的在前。
+	 */
+	std::list<Page*> recentPages;
+
+	size_t nodeCount = 0;
+	size_t residentNodeCount = 0;
+	size_t pageFaultCount = 0;
+	size_t evictionCount = 0;
+
+};
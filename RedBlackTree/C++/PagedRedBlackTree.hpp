@@ -0,0 +1,443 @@
+/**
+ * Paged Red Black Tree Hpp
+ * by Flower Black
+ * 2022.1
+ * at Yushan County, Shangrao, Jiangxi
+ */
+
+#pragma once
+
+#include <cerrno>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "PagedRedBlackTree.h"
+#include "RedBlackTreeSerializer.hpp"
+
+template<typename KeyType, typename DataType>
+PagedRedBlackTree<KeyType, DataType>::PagedRedBlackTree(
+	const std::string& swapPath,
+	const PagedRedBlackTreeOptions& options
+) : options(options), swapPath(swapPath)
+{
+	if (options.pageNodeCount < 2) {
+		throw std::runtime_error("a page must hold at least two nodes.");
+	}
+
+	this->swapFileDescriptor = open(
+		swapPath.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600
+	);
+	if (this->swapFileDescriptor < 0) {
+		throw std::runtime_error("failed to open " + swapPath + ": " + std::strerror(errno));
+	}
+
+	// 交换文件只在本对象的生命期内有意义。删除目录项后，关闭文件时空间自动回收。
+	unlink(swapPath.c_str());
+}
+
+template<typename KeyType, typename DataType>
+PagedRedBlackTree<KeyType, DataType>::~PagedRedBlackTree()
+{
+	this->directory.forEach([](const KeyType&, Page*& page) {
+		delete page;
+	});
+
+	if (this->swapFileDescriptor >= 0) {
+		close(this->swapFileDescriptor);
+		this->swapFileDescriptor = -1;
+	}
+}
+
+template<typename KeyType, typename DataType>
+bool PagedRedBlackTree<KeyType, DataType>::hasKey(const KeyType& queryKey)
+{
+	DirectoryHandle pageHandle = this->directory.lowerBound(queryKey);
+	if (!pageHandle.isValid()) {
+		return false; // 比所有页的最大键都大。
+	}
+
+	Page* page = pageHandle.data();
+	this->touch(page);
+	return page->tree.hasKey(queryKey);
+}
+
+template<typename KeyType, typename DataType>
+DataType PagedRedBlackTree<KeyType, DataType>::getData(const KeyType& key)
+{
+	DirectoryHandle pageHandle = this->directory.lowerBound(key);
+	if (!pageHandle.isValid()) {
+		throw std::runtime_error("could not find your key in the object."); // 找不到对应键。抛出异常。
+	}
+
+	Page* page = pageHandle.data();
+	this->touch(page);
+	return page->tree.getData(key);
+}
+
+template<typename KeyType, typename DataType>
+PagedRedBlackTree<KeyType, DataType>& PagedRedBlackTree<KeyType, DataType>::setData(
+	const KeyType& key,
+	const DataType& data
+)
+{
+	DirectoryHandle pageHandle = this->directory.lowerBound(key);
+	Page* page;
+
+	if (pageHandle.isValid()) {
+		page = pageHandle.data();
+		this->touch(page);
+	}
+	else if (this->directory.isEmpty()) {
+		// 第一页。
+		page = new Page();
+		try {
+			this->directory.setData(key, page);
+		}
+		catch (...) {
+			delete page;
+			throw;
+		}
+		this->recentPages.push_front(page);
+		page->recentPosition = this->recentPages.begin();
+	}
+	else {
+		// 比所有键都大：放进最后一页，并把该页的键改成新的最大键。
+		pageHandle = this->directory.max();
+		page = pageHandle.data();
+		this->touch(page);
+		this->directory.rekey(pageHandle, key);
+	}
+
+	bool created;
+	typename RedBlackTree<KeyType, DataType>::Node* node = page->tree.findOrCreateNode(key, created);
+	node->data = data;
+	page->dirty = true;
+
+	if (created) {
+		page->nodeCount++;
+		this->nodeCount++;
+		this->residentNodeCount++;
+
+		if (page->nodeCount > this->options.pageNodeCount) {
+			this->splitPage(page);
+		}
+
+		// 数据已经写入，换出失败不应让调用者以为写入失败。未能换出的页保持常驻，下次换出时重试。
+		try {
+			this->evictOverBudget(page);
+		}
+		catch (...) {
+		}
+	}
+
+	return *this;
+}
+
+template<typename KeyType, typename DataType>
+PagedRedBlackTree<KeyType, DataType>& PagedRedBlackTree<KeyType, DataType>::removeKey(
+	const KeyType& key
+)
+{
+	DirectoryHandle pageHandle = this->directory.lowerBound(key);
+	if (!pageHandle.isValid()) {
+		throw std::runtime_error("could not find your key in the object."); // 找不到对应键。抛出异常。
+	}
+
+	Page* page = pageHandle.data();
+	this->touch(page);
+	page->tree.removeKey(key); // 找不到键时在这里抛出异常。
+
+	page->nodeCount--;
+	page->dirty = true;
+	this->nodeCount--;
+	this->residentNodeCount--;
+
+	if (page->nodeCount == 0) {
+		KeyType pageKey = pageHandle.key(); // 目录删除该键时会销毁句柄所指的节点，先复制一份。
+		this->destroyPage(pageKey, page);
+	}
+	else if (pageHandle.key() == key) {
+		// 删除的是本页的最大键。新的最大键仍大于前一页的所有键，不会与目录中的键冲突。
+		this->directory.rekey(pageHandle, page->tree.max().key());
+	}
+
+	return *this;
+}
+
+template<typename KeyType, typename DataType>
+bool PagedRedBlackTree<KeyType, DataType>::isEmpty() const
+{
+	return this->nodeCount == 0;
+}
+
+template<typename KeyType, typename DataType>
+template<typename Function>
+void PagedRedBlackTree<KeyType, DataType>::forEach(Function&& function)
+{
+	this->directory.forEach([this, &function](const KeyType&, Page*& page) {
+		this->touch(page);
+		page->dirty = true;
+		page->tree.forEach(function);
+	});
+}
+
+template<typename KeyType, typename DataType>
+template<typename Function>
+void PagedRedBlackTree<KeyType, DataType>::forEachReadOnly(Function&& function)
+{
+	this->directory.forEach([this, &function](const KeyType&, Page*& page) {
+		this->touch(page);
+		page->tree.forEach([&function](const KeyType& key, const DataType& data) {
+			function(key, data);
+		});
+	});
+}
+
+template<typename KeyType, typename DataType>
+size_t PagedRedBlackTree<KeyType, DataType>::getNodeCount() const
+{
+	return this->nodeCount;
+}
+
+template<typename KeyType, typename DataType>
+size_t PagedRedBlackTree<KeyType, DataType>::getResidentNodeCount() const
+{
+	return this->residentNodeCount;
+}
+
+template<typename KeyType, typename DataType>
+size_t PagedRedBlackTree<KeyType, DataType>::getPageFaultCount() const
+{
+	return this->pageFaultCount;
+}
+
+template<typename KeyType, typename DataType>
+size_t PagedRedBlackTree<KeyType, DataType>::getEvictionCount() const
+{
+	return this->evictionCount;
+}
+
+template<typename KeyType, typename DataType>
+void PagedRedBlackTree<KeyType, DataType>::touch(Page* page)
+{
+	if (page->resident) {
+		this->recentPages.splice(this->recentPages.begin(), this->recentPages, page->recentPosition);
+		return;
+	}
+
+	this->loadPage(page);
+	this->evictOverBudget(page);
+}
+
+template<typename KeyType, typename DataType>
+void PagedRedBlackTree<KeyType, DataType>::loadPage(Page* page)
+{
+	std::string content(static_cast<size_t>(page->slotLength), '\0');
+	this->readAt(&content[0], content.size(), page->slotOffset);
+
+	// 页中的键按从小到大的顺序写出。以上一个节点为提示插入，不必每次从根下降。
+	const char* cursor = content.data();
+	const char* end = content.data() + content.size();
+	typename RedBlackTree<KeyType, DataType>::Node* previousNode = nullptr;
+
+	try {
+		for (size_t i = 0; i < page->nodeCount; i++) {
+			KeyType key;
+			DataType data;
+			if (!RedBlackTreeSerializer<KeyType>::read(cursor, end, key)
+				|| !RedBlackTreeSerializer<DataType>::read(cursor, end, data))
+			{
+				throw std::runtime_error("swap file " + this->swapPath + " is corrupted.");
+			}
+
+			bool created;
+			previousNode = page->tree.findOrCreateNodeNear(previousNode, key, created);
+			previousNode->data = std::move(data);
+		}
+	}
+	catch (...) {
+		page->tree.clear();
+		throw;
+	}
+
+	this->recentPages.push_front(page);
+	page->recentPosition = this->recentPages.begin();
+	page->resident = true;
+	page->dirty = false;
+
+	this->residentNodeCount += page->nodeCount;
+	this->pageFaultCount++;
+}
+
+template<typename KeyType, typename DataType>
+void PagedRedBlackTree<KeyType, DataType>::evictPage(Page* page)
+{
+	if (page->dirty) {
+		std::string content;
+		page->tree.forEach([&content](const KeyType& key, DataType& data) {
+			RedBlackTreeSerializer<KeyType>::write(content, key);
+			RedBlackTreeSerializer<DataType>::write(content, data);
+		});
+
+		if (content.size() > page->slotCapacity) {
+			this->releaseSlot(page);
+			this->allocateSlot(page, content.size());
+		}
+
+		this->writeAt(content.data(), content.size(), page->slotOffset);
+		page->slotLength = content.size();
+		page->dirty = false;
+	}
+
+	page->tree.clear();
+	page->resident = false;
+	this->recentPages.erase(page->recentPosition);
+
+	this->residentNodeCount -= page->nodeCount;
+	this->evictionCount++;
+}
+
+template<typename KeyType, typename DataType>
+void PagedRedBlackTree<KeyType, DataType>::evictOverBudget(Page* keep)
+{
+	while (this->residentNodeCount > this->options.residentNodeBudget) {
+		Page* victim = this->recentPages.back();
+		if (victim == keep) {
+			victim = this->recentPages.size() > 1 ? *std::prev(this->recentPages.end(), 2) : nullptr;
+			if (victim == nullptr) {
+				break; // 只剩正在访问的页。
+			}
+		}
+
+		this->evictPage(victim);
+	}
+}
+
+template<typename KeyType, typename DataType>
+void PagedRedBlackTree<KeyType, DataType>::splitPage(Page* page)
+{
+	Page* lowerPage = new Page();
+	size_t movedCount = page->nodeCount / 2;
+
+	try {
+		typename RedBlackTree<KeyType, DataType>::Node* previousNode = nullptr;
+		for (size_t i = 0; i < movedCount; i++) {
+			std::pair<KeyType, DataType> element = page->tree.popMin();
+
+			bool created;
+			previousNode = lowerPage->tree.findOrCreateNodeNear(previousNode, element.first, created);
+			previousNode->data = std::move(element.second);
+		}
+
+		this->directory.setData(lowerPage->tree.max().key(), lowerPage);
+	}
+	catch (...) {
+		// 把已经移出的元素放回去。
+		while (!lowerPage->tree.isEmpty()) {
+			std::pair<KeyType, DataType> element = lowerPage->tree.popMin();
+			page->tree.setData(element.first, element.second);
+		}
+		delete lowerPage;
+		throw;
+	}
+
+	page->nodeCount -= movedCount;
+	lowerPage->nodeCount = movedCount;
+
+	// 新页排在原页之后：两者同时被访问，原页更可能继续被访问。
+	lowerPage->recentPosition = this->recentPages.insert(std::next(page->recentPosition), lowerPage);
+}
+
+template<typename KeyType, typename DataType>
+void PagedRedBlackTree<KeyType, DataType>::destroyPage(const KeyType& pageKey, Page* page)
+{
+	if (page->resident) {
+		this->recentPages.erase(page->recentPosition);
+	}
+	this->releaseSlot(page);
+	this->directory.removeKey(pageKey);
+	delete page;
+}
+
+template<typename KeyType, typename DataType>
+void PagedRedBlackTree<KeyType, DataType>::allocateSlot(Page* page, uint64_t length)
+{
+	auto freeSlot = this->freeSlots.lower_bound(length);
+	if (freeSlot != this->freeSlots.end()) {
+		page->slotCapacity = freeSlot->first;
+		page->slotOffset = freeSlot->second;
+		this->freeSlots.erase(freeSlot);
+		return;
+	}
+
+	// 预留一些余量，页稍微变大时可以原地重写。
+	uint64_t capacity = length + length / 4;
+	page->slotOffset = this->swapFileSize;
+	page->slotCapacity = capacity;
+	this->swapFileSize += capacity;
+}
+
+template<typename KeyType, typename DataType>
+void PagedRedBlackTree<KeyType, DataType>::releaseSlot(Page* page)
+{
+	if (page->slotCapacity == 0) {
+		return;
+	}
+
+	this->freeSlots.emplace(page->slotCapacity, page->slotOffset);
+	page->slotOffset = 0;
+	page->slotLength = 0;
+	page->slotCapacity = 0;
+}
+
+template<typename KeyType, typename DataType>
+void PagedRedBlackTree<KeyType, DataType>::writeAt(
+	const char* buffer,
+	size_t length,
+	uint64_t offset
+)
+{
+	while (length > 0) {
+		ssize_t written = pwrite(this->swapFileDescriptor, buffer, length, static_cast<off_t>(offset));
+		if (written < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			throw std::runtime_error("failed to write " + this->swapPath + ": " + std::strerror(errno));
+		}
+		buffer += written;
+		length -= static_cast<size_t>(written);
+		offset += static_cast<uint64_t>(written);
+	}
+}
+
+template<typename KeyType, typename DataType>
+void PagedRedBlackTree<KeyType, DataType>::readAt(
+	char* buffer,
+	size_t length,
+	uint64_t offset
+)
+{
+	while (length > 0) {
+		ssize_t bytesRead = pread(this->swapFileDescriptor, buffer, length, static_cast<off_t>(offset));
+		if (bytesRead < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			throw std::runtime_error("failed to read " + this->swapPath + ": " + std::strerror(errno));
+		}
+		if (bytesRead == 0) {
+			throw std::runtime_error("swap file " + this->swapPath + " is corrupted.");
+		}
+		buffer += bytesRead;
+		length -= static_cast<size_t>(bytesRead);
+		offset += static_cast<uint64_t>(bytesRead);
+	}
+}
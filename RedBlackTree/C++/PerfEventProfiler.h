@@ -0,0 +1,128 @@
+/**
+ * Perf Event Profiler H
+ * by Flower Black
+ * 2022.1
+ * at Yushan County, Shangrao, Jiangxi
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+/**
+ * 采集的硬件计数器。
+ */
+enum class PerfEventCounter {
+	CYCLES,
+	INSTRUCTIONS,
+	LLC_MISSES,
+	BRANCH_MISSES,
+	DTLB_MISSES
+};
+
+/**
+ * 一次测量的结果。计数器的值已经按复用（multiplexing）时间换算过。
+ */
+struct PerfEventReport {
+	static constexpr size_t COUNTER_COUNT = 5;
+
+	/** 测量名称。 */
+	std::string name;
+
+	/** 测量期间执行的操作数。用于计算每次操作的平均值。 */
+	size_t operationCount = 0;
+
+	/** 测量期间经过的时间（纳秒）。 */
+	double nanoseconds = 0;
+
+	/** 各计数器的值，按 PerfEventCounter 的顺序排列。 */
+	double counters[COUNTER_COUNT] = {};
+
+	/** 各计数器是否可用。不可用的计数器打印为 n/a. */
+	bool available[COUNTER_COUNT] = {};
+
+	/**
+	 * 打印表头。
+	 * 
+	 * @param out 输出文件。
+	 */
+	static void printHeader(FILE* out);
+
+	/**
+	 * 打印每次操作的平均值。
+	 * 
+	 * @param out 输出文件。
+	 */
+	void print(FILE* out) const;
+};
+
+/**
+ * 基于 Linux perf_event_open 的硬件计数器采集器。
+ * 
+ * 只统计调用线程在用户态的事件。
+ * 各计数器独立打开，某个计数器不可用（内核不支持、权限不足、在虚拟机中等）时只影响它自己；
+ * 全部不可用时仍然可以测量时间。
+ */
+class PerfEventProfiler {
+
+public:
+	/** 采集器的生命相关操作。 */
+
+	/**
+	 * 打开所有计数器。打开失败的计数器会被标记为不可用，不会抛出异常。
+	 */
+	PerfEventProfiler();
+
+	/**
+	 * 关闭所有计数器。
+	 */
+	~PerfEventProfiler();
+
+	PerfEventProfiler(const PerfEventProfiler&) = delete;
+	PerfEventProfiler& operator = (const PerfEventProfiler&) = delete;
+
+public:
+	/** 测量操作。 */
+
+	/**
+	 * 判断计数器是否可用。
+	 */
+	bool isAvailable(PerfEventCounter counter) const;
+
+	/**
+	 * 所有计数器都不可用时，第一个计数器打开失败的原因。否则为空。
+	 */
+	const std::string& getUnavailableReason() const;
+
+	/**
+	 * 测量一段代码。
+	 * 
+	 * @param name 测量名称。
+	 * @param operationCount 这段代码执行的操作数。
+	 * @param function 被测量的代码，形如 void()。
+	 * @return 测量结果。
+	 */
+	template <typename Function>
+	PerfEventReport measure(const std::string& name, size_t operationCount, Function&& function);
+
+private:
+	/**
+	 * 重置并启动所有可用的计数器。
+	 */
+	void start();
+
+	/**
+	 * 停止所有计数器，并把读数写入测量结果。
+	 * 
+	 * @param report 测量结果。
+	 */
+	void stop(PerfEventReport& report);
+
+private:
+	int fileDescriptors[PerfEventReport::COUNTER_COUNT];
+	std::string unavailableReason;
+
+};
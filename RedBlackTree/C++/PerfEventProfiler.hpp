@@ -0,0 +1,191 @@
+/**
+ * Perf Event Profiler Hpp
+ * by Flower Black
+ * 2022.1
+ * at Yushan County, Shangrao, Jiangxi
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cerrno>
+#include <cstring>
+#include <utility>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "PerfEventProfiler.h"
+
+inline void PerfEventReport::printHeader(FILE* out)
+{
+	std::fprintf(
+		out, "%-40s %10s %10s %10s %6s %10s %10s %10s\n",
+		"workload", "ns/op", "cycles/op", "instr/op", "IPC", "LLC-m/op", "br-m/op", "dTLB-m/op"
+	);
+}
+
+inline void PerfEventReport::print(FILE* out) const
+{
+	double operations = this->operationCount == 0 ? 1.0 : double(this->operationCount);
+
+	std::fprintf(out, "%-40s %10.1f", this->name.c_str(), this->nanoseconds / operations);
+
+	auto printCounter = [&] (PerfEventCounter counter, const char* format) {
+		size_t index = static_cast<size_t>(counter);
+		if (this->available[index]) {
+			std::fprintf(out, format, this->counters[index] / operations);
+		}
+		else {
+			std::fprintf(out, " %10s", "n/a");
+		}
+	};
+
+	printCounter(PerfEventCounter::CYCLES, " %10.1f");
+	printCounter(PerfEventCounter::INSTRUCTIONS, " %10.1f");
+
+	size_t cycles = static_cast<size_t>(PerfEventCounter::CYCLES);
+	size_t instructions = static_cast<size_t>(PerfEventCounter::INSTRUCTIONS);
+	if (this->available[cycles] && this->available[instructions] && this->counters[cycles] > 0) {
+		std::fprintf(out, " %6.2f", this->counters[instructions] / this->counters[cycles]);
+	}
+	else {
+		std::fprintf(out, " %6s", "n/a");
+	}
+
+	printCounter(PerfEventCounter::LLC_MISSES, " %10.3f");
+	printCounter(PerfEventCounter::BRANCH_MISSES, " %10.3f");
+	printCounter(PerfEventCounter::DTLB_MISSES, " %10.3f");
+	std::fprintf(out, "\n");
+}
+
+inline PerfEventProfiler::PerfEventProfiler()
+{
+	struct {
+		uint32_t type;
+		uint64_t config;
+	} events[PerfEventReport::COUNTER_COUNT] = {
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+		{
+			PERF_TYPE_HW_CACHE, 
+			PERF_COUNT_HW_CACHE_DTLB 
+				| (PERF_COUNT_HW_CACHE_OP_READ << 8) 
+				| (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)
+		}
+	};
+
+	bool anyAvailable = false;
+	std::string firstError;
+
+	for (size_t i = 0; i < PerfEventReport::COUNTER_COUNT; i++) {
+		perf_event_attr attribute;
+		std::memset(&attribute, 0, sizeof(attribute));
+		attribute.size = sizeof(attribute);
+		attribute.type = events[i].type;
+		attribute.config = events[i].config;
+		attribute.disabled = 1;
+		attribute.exclude_kernel = 1;
+		attribute.exclude_hv = 1;
+		attribute.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+		// 统计调用线程，不限定 CPU.
+		long result = syscall(SYS_perf_event_open, &attribute, 0, -1, -1, 0);
+		this->fileDescriptors[i] = static_cast<int>(result);
+
+		if (result >= 0) {
+			anyAvailable = true;
+		}
+		else if (firstError.empty()) {
+			firstError = std::string("perf_event_open failed: ") + std::strerror(errno);
+		}
+	}
+
+	if (!anyAvailable) {
+		this->unavailableReason = firstError;
+	}
+}
+
+inline PerfEventProfiler::~PerfEventProfiler()
+{
+	for (int fileDescriptor : this->fileDescriptors) {
+		if (fileDescriptor >= 0) {
+			close(fileDescriptor);
+		}
+	}
+}
+
+inline bool PerfEventProfiler::isAvailable(PerfEventCounter counter) const
+{
+	return this->fileDescriptors[static_cast<size_t>(counter)] >= 0;
+}
+
+inline const std::string& PerfEventProfiler::getUnavailableReason() const
+{
+	return this->unavailableReason;
+}
+
+template<typename Function>
+PerfEventReport PerfEventProfiler::measure(
+	const std::string& name, 
+	size_t operationCount, 
+	Function&& function
+)
+{
+	PerfEventReport report;
+	report.name = name;
+	report.operationCount = operationCount;
+
+	auto startTime = std::chrono::steady_clock::now();
+	this->start();
+	std::forward<Function>(function)();
+	this->stop(report);
+	auto endTime = std::chrono::steady_clock::now();
+
+	report.nanoseconds = std::chrono::duration<double, std::nano>(endTime - startTime).count();
+	return report;
+}
+
+inline void PerfEventProfiler::start()
+{
+	for (int fileDescriptor : this->fileDescriptors) {
+		if (fileDescriptor >= 0) {
+			ioctl(fileDescriptor, PERF_EVENT_IOC_RESET, 0);
+			ioctl(fileDescriptor, PERF_EVENT_IOC_ENABLE, 0);
+		}
+	}
+}
+
+inline void PerfEventProfiler::stop(PerfEventReport& report)
+{
+	for (int fileDescriptor : this->fileDescriptors) {
+		if (fileDescriptor >= 0) {
+			ioctl(fileDescriptor, PERF_EVENT_IOC_DISABLE, 0);
+		}
+	}
+
+	for (size_t i = 0; i < PerfEventReport::COUNTER_COUNT; i++) {
+		report.available[i] = false;
+		if (this->fileDescriptors[i] < 0) {
+			continue;
+		}
+
+		// 读数格式：计数值、启用时间、实际计数时间。
+		uint64_t values[3];
+		if (read(this->fileDescriptors[i], values, sizeof(values)) != sizeof(values)) {
+			continue;
+		}
+
+		if (values[2] == 0) {
+			continue; // 计数器被复用，测量期间一直没有轮到它。
+		}
+
+		double scale = values[2] < values[1] ? double(values[1]) / double(values[2]) : 1.0;
+		report.counters[i] = double(values[0]) * scale;
+		report.available[i] = true;
+	}
+}
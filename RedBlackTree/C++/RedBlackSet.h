@@ -0,0 +1,71 @@
+/**
+ * Red Black Set H
+ * by Flower Black
+ * 2022.1
+ * at Yushan County, Shangrao, Jiangxi
+ */
+
+#pragma once
+
+#include "RedBlackTree.hpp"
+
+/**
+ * 红黑集合：只存键、不存数据的红黑树。
+ * 节点中没有数据域，插入时也不需要拷贝占位数据。
+ */
+template <typename KeyType>
+class RedBlackSet {
+
+public:
+	/** 集合的生命相关操作。 */
+	RedBlackSet();
+	~RedBlackSet();
+
+	/**
+	 * 清空集合中所有元素。
+	 */
+	void clear();
+
+public:
+	/** 集合的基本操作。 */
+
+	/**
+	 * 判断键是否在集合里。
+	 * 
+	 * @param queryKey 待判断的键。
+	 * @return 是否在集合中找到了对应键。
+	 */
+	bool hasKey(const KeyType& queryKey);
+
+	/**
+	 * 插入键。如果键已经存在，不做任何事。
+	 * 
+	 * @param key 键。
+	 * @return 红黑集合对象自身。
+	 */
+	RedBlackSet<KeyType>& insertKey(const KeyType& key);
+
+	/**
+	 * 删除键。
+	 * 
+	 * @param key 键。
+	 * @return 红黑集合对象自身。
+	 * @exception runtime_error 如果无法找到键，会抛出异常。
+	 */
+	RedBlackSet<KeyType>& removeKey(const KeyType& key);
+
+	/**
+	 * 按从小到大的顺序访问每个键。
+	 * 
+	 * @param function 访问函数，形如 void(const KeyType& key)。
+	 */
+	template <typename Function>
+	void forEach(Function&& function);
+
+private:
+	/**
+	 * 存放键的红黑树。数据类型为空占位类型。
+	 */
+	RedBlackTree<KeyType, RedBlackSetNoData> tree;
+
+};
@@ -0,0 +1,56 @@
+/**
+ * Red Black Set Hpp
+ * by Flower Black
+ * 2022.1
+ * at Yushan County, Shangrao, Jiangxi
+ */
+
+#pragma once
+
+#include "RedBlackSet.h"
+
+template<typename KeyType>
+RedBlackSet<KeyType>::RedBlackSet()
+{
+}
+
+template<typename KeyType>
+RedBlackSet<KeyType>::~RedBlackSet()
+{
+}
+
+template<typename KeyType>
+void RedBlackSet<KeyType>::clear()
+{
+	this->tree.clear();
+}
+
+template<typename KeyType>
+bool RedBlackSet<KeyType>::hasKey(const KeyType& queryKey)
+{
+	return this->tree.hasKey(queryKey);
+}
+
+template<typename KeyType>
+RedBlackSet<KeyType>& RedBlackSet<KeyType>::insertKey(const KeyType& key)
+{
+	bool created;
+	this->tree.findOrCreateNode(key, created);
+	return *this;
+}
+
+template<typename KeyType>
+RedBlackSet<KeyType>& RedBlackSet<KeyType>::removeKey(const KeyType& key)
+{
+	this->tree.removeKey(key);
+	return *this;
+}
+
+template<typename KeyType>
+template<typename Function>
+void RedBlackSet<KeyType>::forEach(Function&& function)
+{
+	this->tree.forEach([&function](const KeyType& key, const RedBlackSetNoData&) {
+		function(key);
+	});
+}
@@ -7,19 +7,161 @@
 
 #pragma once
 
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#include "RedBlackTreeHashIndex.h"
+#include "RedBlackTreeHotKeyCache.h"
+#include "RedBlackTreeKeyPrefix.h"
+#include "RedBlackTreeNodeData.h"
+#include "RedBlackTreeNodePool.h"
+
+class WorkStealingThreadPool;
+
+/**
+ * 后台释放节点的线程的计数。所有类型的树共用一份，供 RedBlackTree::waitForDeferredDestruction 等待。
+ */
+class RedBlackTreeReclaimWorkers {
+
+public:
+	/**
+	 * 创建线程前调用，登记一个线程。
+	 */
+	static void enter();
+
+	/**
+	 * 线程创建失败时调用，撤销登记。
+	 */
+	static void cancel();
+
+	/**
+	 * 由线程在工作完成后调用。线程完全退出（包括线程局部变量的析构）后才通知等待者。
+	 */
+	static void leaveAtThreadExit();
+
+	/**
+	 * 等待所有登记的线程退出。
+	 */
+	static void waitAll();
+
+private:
+	struct State {
+		std::mutex mutex;
+		std::condition_variable condition;
+		size_t count = 0;
+	};
+
+	/**
+	 * 共享的状态。有意不释放：退出中的线程在解锁之后还会通知条件变量，此时 main 可能已经返回。
+	 */
+	static State& state();
+
+};
+
+template <typename KeyType>
+class RedBlackSet;
+
+template <typename KeyType, typename DataType>
+class BufferedRedBlackTree;
+
+template <typename KeyType, typename DataType>
+class PagedRedBlackTree;
+
 template <typename KeyType, typename DataType>
 class RedBlackTree {
 
+	friend class RedBlackSet<KeyType>;
+	friend class BufferedRedBlackTree<KeyType, DataType>;
+	friend class PagedRedBlackTree<KeyType, DataType>;
+
+private:
+	struct Node;
+
+public:
+	/**
+	 * 指向树中某个元素的句柄。用于在不重新查找的情况下访问或改键。
+	 * 
+	 * 元素被删除，或被 compactLayout 搬迁后，句柄失效。clear 会使所有句柄失效。
+	 */
+	class Handle {
+	public:
+		Handle() = default;
+
+		/**
+		 * 元素的键。
+		 */
+		const KeyType& key() const;
+
+		/**
+		 * 元素的数据。
+		 */
+		DataType& data() const;
+
+		/**
+		 * 句柄是否指向元素。默认构造的句柄不指向任何元素。
+		 */
+		bool isValid() const;
+
+		/**
+		 * 按键从小到大的顺序，下一个元素的句柄。借助父节点指针，均摊 O(1).
+		 * 
+		 * @return 下一个元素的句柄。没有下一个元素时，返回的句柄无效。
+		 */
+		Handle next() const;
+
+	private:
+		friend class RedBlackTree;
+
+		explicit Handle(Node* node) : node(node) {}
+
+		Node* node = nullptr;
+	};
+
 public:
 	/** 树的生命相关操作。 */
 	RedBlackTree();
+
+	/**
+	 * 释放所有节点。启用了延迟析构时，节点交给后台线程释放，析构函数立即返回。
+	 */
 	~RedBlackTree();
 
 	/**
 	 * 清空树中所有元素。
+	 * 节点析构不使用递归；键和数据都不需要析构时，直接按块归还内存，不遍历节点。
 	 */
 	void clear();
 
+	/**
+	 * 异步清空：在 O(1) 时间内把所有节点从树上摘下，交给后台线程析构并归还内存。
+	 * 返回后树即为空，可以立刻继续使用。哈希索引在当前线程中清空。
+	 * 上一次异步清空尚未完成时，会先等待它完成。
+	 * 无法创建线程时，退化为同步清空。
+	 */
+	void clearAsync();
+
+	/**
+	 * 设置是否延迟析构。启用后，析构函数把节点交给一个分离的后台线程释放；
+	 * 尚未完成的异步清空也会被分离，而不是等待。
+	 * 分离的线程可能比树活得更久。使用了延迟析构的程序必须在 main 返回
+	 * （或键、数据的析构所依赖的状态销毁）之前调用 waitForDeferredDestruction.
+	 * 
+	 * @param enabled 是否启用。
+	 */
+	void setDeferredDestruction(bool enabled);
+
+	/**
+	 * 等待所有树（任意类型）的后台释放线程结束，包括延迟析构与异步清空的线程。
+	 * 返回后不再有释放节点的后台线程在运行。
+	 */
+	static void waitForDeferredDestruction();
+
 public:
 	/** 树的基本查询操作。 */
 
@@ -56,6 +198,262 @@ public:
 	 */
 	RedBlackTree<KeyType, DataType>& removeKey(const KeyType& key);
 
+	/**
+	 * 判断树是否为空。
+	 */
+	bool isEmpty() const;
+
+	/**
+	 * 获取键对应元素的句柄。
+	 * 
+	 * @param key 键。
+	 * @return 句柄。
+	 * @exception runtime_error 如果无法找到键，会抛出异常。
+	 */
+	Handle getHandle(const KeyType& key);
+
+	/**
+	 * 获取第一个键不小于 key 的元素的句柄。总是从根下降，不使用哈希索引。
+	 * 与 Handle::next 配合，可以从任意位置开始按序遍历。
+	 * 
+	 * @param key 键。
+	 * @return 句柄。所有键都小于 key 时，返回的句柄无效。
+	 */
+	Handle lowerBound(const KeyType& key);
+
+public:
+	/** 读-改-写操作。以下操作都只查找一次：找到或创建节点后，直接在节点中修改数据。 */
+
+	/**
+	 * 获取键对应的数据；键不存在时，以 factory() 的返回值创建元素。
+	 * 新数据直接由返回值初始化，不经过默认构造与拷贝。
+	 * 
+	 * @param key 键。
+	 * @param factory 工厂函数，形如 DataType()。只在键不存在时调用。
+	 * @return 键对应的数据。
+	 */
+	template <typename Factory>
+	DataType& getOrInsert(const KeyType& key, Factory&& factory);
+
+	/**
+	 * 就地修改键对应的数据；键不存在时，先以值初始化的数据（如整数为 0）创建元素。
+	 * 例如计数：tree.upsert(word, [] (long& count) { count++; });
+	 * 
+	 * @param key 键。
+	 * @param function 修改函数，形如 void(DataType& data)。
+	 * @return 键对应的数据。
+	 * @exception 修改函数抛出的异常。此时新创建的元素会被删除，已有的元素保持函数修改后的状态。
+	 */
+	template <typename Function>
+	DataType& upsert(const KeyType& key, Function&& function);
+
+	/**
+	 * 键存在时就地修改其数据；键不存在时不做任何事。
+	 * 修改函数返回 bool 时，返回 false 表示删除该元素（例如引用计数减到 0）。
+	 * 
+	 * @param key 键。
+	 * @param function 修改函数，形如 void(DataType& data) 或 bool(DataType& data)。
+	 * @return 是否找到了键。
+	 */
+	template <typename Function>
+	bool computeIfPresent(const KeyType& key, Function&& function);
+
+public:
+	/** 优先队列操作。树缓存了最左与最右节点，以下操作不需要从根向下查找。 */
+
+	/**
+	 * 获取键最小的元素。O(1).
+	 * 
+	 * @return 句柄。
+	 * @exception runtime_error 树为空时抛出。
+	 */
+	Handle min();
+
+	/**
+	 * 获取键最大的元素。O(1).
+	 * 
+	 * @return 句柄。
+	 * @exception runtime_error 树为空时抛出。
+	 */
+	Handle max();
+
+	/**
+	 * 删除键最小的元素，并返回其键与数据。均摊 O(1)，另加删除后的平衡修复。
+	 * 
+	 * @return 被删除元素的键与数据。
+	 * @exception runtime_error 树为空时抛出。
+	 */
+	std::pair<KeyType, DataType> popMin();
+
+	/**
+	 * 删除键最大的元素，并返回其键与数据。
+	 * 
+	 * @return 被删除元素的键与数据。
+	 * @exception runtime_error 树为空时抛出。
+	 */
+	std::pair<KeyType, DataType> popMax();
+
+	/**
+	 * 修改元素的键（例如重新安排定时器的到期时间）。
+	 * 节点本身被摘下后以新键重新挂上，数据不被复制，句柄保持有效。
+	 * 
+	 * @param handle 元素的句柄。
+	 * @param newKey 新键。
+	 * @return 红黑树对象自身。
+	 * @exception runtime_error 句柄为空，或新键已经存在时抛出。此时树不变。
+	 */
+	RedBlackTree<KeyType, DataType>& rekey(const Handle& handle, const KeyType& newKey);
+
+public:
+	/** 树的遍历操作。 */
+
+	/**
+	 * 按键从小到大的顺序访问每个元素。
+	 * 遍历借助父节点指针完成，不使用递归。遍历过程中不可修改树的结构。
+	 * 
+	 * @param function 访问函数，形如 void(const KeyType& key, DataType& data)。
+	 */
+	template <typename Function>
+	void forEach(Function&& function);
+
+	/**
+	 * 并行访问每个元素。树按子树拆分成任务，交给工作窃取线程池执行；
+	 * 子树足够小（深度超过截断深度）后在单个线程内顺序遍历。
+	 * 访问顺序不确定，访问函数会被多个线程同时调用，但每个元素只被访问一次。
+	 * 遍历过程中不可修改树的结构。
+	 * 
+	 * @param function 访问函数，形如 void(const KeyType& key, DataType& data)。需要是线程安全的。
+	 * @param pool 执行任务的线程池。
+	 * @exception 访问函数抛出的第一个异常会在所有任务结束后重新抛出。
+	 */
+	template <typename Function>
+	void parallelForEach(Function&& function, WorkStealingThreadPool& pool);
+
+	/**
+	 * 同上。使用临时线程池，线程数为硬件线程数。
+	 */
+	template <typename Function>
+	void parallelForEach(Function&& function);
+
+	/**
+	 * 并行归约。结果与按键从小到大的顺序依次合并相同：
+	 *   combine(...combine(combine(identity, map(k1, d1)), map(k2, d2))..., map(kn, dn))
+	 * 因此合并函数只需满足结合律，不要求交换律。
+	 * 每个子任务计算一棵子树的结果，再按“左子树、节点、右子树”的顺序合并。
+	 * 遍历过程中不可修改树的结构。
+	 * 
+	 * @param identity 合并的单位元。空树返回该值。
+	 * @param map 映射函数，形如 ResultType(const KeyType& key, DataType& data)。需要是线程安全的。
+	 * @param combine 合并函数，形如 ResultType(const ResultType& left, const ResultType& right)。
+	 * @param pool 执行任务的线程池。
+	 * @return 归约结果。
+	 * @exception 映射或合并函数抛出的第一个异常会在所有任务结束后重新抛出。
+	 */
+	template <typename ResultType, typename MapFunction, typename CombineFunction>
+	ResultType parallelReduce(
+		const ResultType& identity,
+		MapFunction&& map,
+		CombineFunction&& combine,
+		WorkStealingThreadPool& pool
+	);
+
+	/**
+	 * 同上。使用临时线程池，线程数为硬件线程数。
+	 */
+	template <typename ResultType, typename MapFunction, typename CombineFunction>
+	ResultType parallelReduce(
+		const ResultType& identity,
+		MapFunction&& map,
+		CombineFunction&& combine
+	);
+
+public:
+	/** 内存布局相关操作。 */
+
+	/**
+	 * 增量整理节点的内存布局，恢复长期增删之后丢失的局部性。
+	 * 
+	 * 一轮整理开始时，现有的内存块全部退役；之后按键从小到大的顺序，
+	 * 把位于退役块中的节点依次搬到新块里，使中序相邻的节点在内存中也相邻。
+	 * 退役块中的节点全部搬走后，块立即归还给系统。
+	 * 
+	 * 每次调用最多访问 budget 个节点，因此可以穿插在正常请求之间执行。
+	 * 两次调用之间可以照常增删改查。整理中途插入的节点不会被搬迁。
+	 * 
+	 * 注意：被搬迁的节点地址会改变，之前通过 getData 得到的引用会失效。
+	 *
+	 * 注意：一轮整理开始后，必须反复调用直到返回 true. 退役块中空出的槽位不会被复用，
+	 * 块要等其中的节点全部搬走或删除后才归还，而这期间新插入的节点都分配在新块里。
+	 * 如果半途停止调用，退役块会一直占着内存，之后的插入还会继续申请新块，内存占用只增不减。
+	 *
+	 * @param budget 本次调用最多访问的节点数。
+	 * @return 本轮整理是否已经完成。完成后再次调用会开始新的一轮。
+	 */
+	bool compactLayout(size_t budget);
+
+public:
+	/** 哈希索引相关操作。 */
+
+	/**
+	 * 启用哈希索引：另建一张键到节点的开放寻址哈希表，
+	 * 使 hasKey、getData、setData 更新已有键、removeKey 的查找变为期望 O(1)。
+	 * 有序操作（遍历、最值等）照常使用树。
+	 * 
+	 * 索引每个键约占 32 字节（装载因子不超过 1/2，每个槽位 16 字节）。
+	 * 要求 std::hash<KeyType> 可用。已启用时不做任何事。
+	 */
+	void enableHashIndex();
+
+	/**
+	 * 停用哈希索引并释放其内存。
+	 */
+	void disableHashIndex();
+
+	/**
+	 * 判断哈希索引是否已启用。
+	 */
+	bool isHashIndexEnabled() const;
+
+	/**
+	 * 哈希索引占用的内存（字节）。未启用时为 0.
+	 */
+	size_t getHashIndexMemoryUsage() const;
+
+public:
+	/** 热键缓存相关操作。 */
+
+	/**
+	 * 启用热键缓存：一张容量固定的直接映射表，记录最近查到的键对应的节点。
+	 * hasKey、getData、setData 更新已有键、removeKey 先查缓存，命中时不必下降。
+	 * 适合访问集中在少量热键上的场景。哈希冲突的键互相覆盖，缓存不会增长。
+	 * 
+	 * 注意：启用后，hasKey、getData 等读操作也会写入缓存和命中统计，
+	 * 因此不能再由多个线程同时读同一棵树（未启用时可以）。
+	 * 
+	 * 每个槽位 16 字节。要求 std::hash<KeyType> 可用。
+	 * 已启用时，按新容量重建缓存，命中统计清零。
+	 * 
+	 * @param capacity 槽位数。向上取整为 2 的幂。
+	 */
+	void enableHotKeyCache(size_t capacity);
+
+	/**
+	 * 停用热键缓存并释放其内存。
+	 */
+	void disableHotKeyCache();
+
+	/**
+	 * 判断热键缓存是否已启用。
+	 */
+	bool isHotKeyCacheEnabled() const;
+
+	/**
+	 * 热键缓存的命中与未命中次数。未启用时为 0.
+	 * 只统计读接口（hasKey、getData、getHandle）的查找；写操作内部的查找不计入。
+	 */
+	size_t getHotKeyCacheHitCount() const;
+	size_t getHotKeyCacheMissCount() const;
+
 private:
 	enum class NodeColor {
 		RED, BLACK
@@ -63,9 +461,14 @@ private:
 	enum class ChildSide {
 		LEFT, RIGHT
 	};
-	struct Node {
+	/**
+	 * 节点中缓存的键前缀。对 std::string 键，多数比较只需读取前缀，不必访问字符串在堆上的内容。
+	 * 其他类型的键不缓存前缀，不占用节点空间。
+	 */
+	using KeyPrefix = RedBlackTreeKeyPrefix<KeyType>;
+
+	struct Node : RedBlackTreeNodeData<DataType>, KeyPrefix {
 		KeyType key;
-		DataType data;
 		NodeColor color = NodeColor::RED;
 		Node* father = nullptr;
 		Node* leftChild = nullptr;
@@ -74,11 +477,184 @@ private:
 
 private:
 	/**
-	 * 释放该节点及其所有子节点。
+	 * 并行遍历时，每个线程约分到的子树数目为 2 的该次方。
+	 * 多拆出一些任务，便于线程之间通过窃取平衡负载。
+	 */
+	static constexpr unsigned PARALLEL_SPLIT_SLACK = 3;
+
+	/**
+	 * 按键从小到大的顺序访问子树中的每个元素。不使用递归。
+	 * 
+	 * @param subtreeRoot 子树的根。可以为 nullptr.
+	 * @param function 访问函数，形如 void(Node* node)。
+	 */
+	template <typename Function>
+	static void forEachNodeInSubtree(Node* subtreeRoot, Function&& function);
+
+	/**
+	 * 计算并行遍历的截断深度：深度达到该值的子树不再拆分。
+	 * 
+	 * @param pool 执行任务的线程池。
+	 */
+	static unsigned parallelCutoffDepth(const WorkStealingThreadPool& pool);
+
+	/**
+	 * 查找键对应的节点。启用了哈希索引时查索引，否则从根下降。
+	 * 
+	 * @param key 键。
+	 * @param countLookup 是否记入热键缓存的命中统计。只有读接口（hasKey、getData、getHandle）记入。
+	 * @return 键对应的节点。找不到时返回 nullptr.
+	 */
+	Node* findNode(const KeyType& key, bool countLookup = false);
+
+	/**
+	 * 查找键对应的节点。找不到时创建新节点（数据为默认值）并修复树的平衡。
+	 * 
+	 * @param key 键。
+	 * @param created 返回是否创建了新节点。
+	 * @return 键对应的节点。
+	 */
+	Node* findOrCreateNode(const KeyType& key, bool& created);
+
+	/**
+	 * 同 findOrCreateNode，但从提示节点附近开始查找（finger search）。
+	 * 按升序连续插入时，以上一次得到的节点为提示，只需从提示节点向上回溯一小段，
+	 * 再向下查找，路径上的节点多半还在缓存里。
+	 * 
+	 * @param hint 提示节点。为 nullptr，或其键不小于 key 时，退化为从根查找。
+	 * @param key 键。
+	 * @param created 返回是否创建了新节点。
+	 * @return 键对应的节点。
+	 */
+	Node* findOrCreateNodeNear(Node* hint, const KeyType& key, bool& created);
+
+	/**
+	 * 查找键对应的节点；找不到时给出插入位置。依次查热键缓存、哈希索引，再从提示节点或根下降。
+	 * 
+	 * @param hint 提示节点。含义同 findOrCreateNodeNear.
+	 * @param key 键。
+	 * @param father 找不到键时，返回新节点应挂到的父节点（树为空时为 nullptr）。
+	 * @return 键对应的节点。找不到时返回 nullptr.
+	 */
+	Node* findNodeOrInsertionPoint(Node* hint, const KeyType& key, Node*& father);
+
+	/**
+	 * 在内存池中创建节点（数据与键为默认值）。
+	 */
+	Node* createNode();
+
+	/**
+	 * 在内存池中创建节点，键拷贝自 key，数据由 factory() 的返回值直接初始化。
+	 */
+	template <typename Factory>
+	Node* createNode(const KeyType& key, Factory&& factory);
+
+	/**
+	 * 析构节点，并将内存还给内存池。
+	 * 
+	 * @param node 已从树上摘下的节点。
+	 */
+	void destroyNode(Node* node);
+
+	/**
+	 * 将节点搬到内存池当前块的末尾，并修正父节点、孩子节点及根节点指针。
+	 * 键、数据、颜色与树的结构都保持不变。
 	 * 
-	 * @param node 递归释放的第一个节点。
+	 * @param node 待搬迁的节点。
+	 * @return 搬迁后的节点。
 	 */
-	void cleanup(Node* node);
+	Node* relocateNode(Node* node);
+
+	/**
+	 * 求中序后继。
+	 * 
+	 * @param node 节点。
+	 * @return 中序后继节点。没有后继时返回 nullptr.
+	 */
+	static Node* successorOf(Node* node);
+
+	/**
+	 * 求中序前驱。
+	 * 
+	 * @param node 节点。
+	 * @return 中序前驱节点。没有前驱时返回 nullptr.
+	 */
+	static Node* predecessorOf(Node* node);
+
+	/**
+	 * 将新节点挂到指定父节点下，并修复树的平衡。
+	 * 
+	 * @param node 键已设好、不在树上的节点。
+	 * @param father 下降查找时最后遍历到的节点。树为空时为 nullptr.
+	 */
+	void attachNode(Node* node, Node* father);
+
+	/**
+	 * 将节点从树上摘下，并修复树的平衡。节点本身不被释放，键与数据保持不变。
+	 * 
+	 * @param node 树上的节点。
+	 */
+	void detachNode(Node* node);
+
+	/**
+	 * 摘下并释放节点，返回其键与数据。
+	 * 
+	 * @param node 树上的节点。
+	 */
+	std::pair<KeyType, DataType> popNode(Node* node);
+
+	/**
+	 * 节点挂上树、摘下或被搬迁时，同步哈希索引。未启用索引时不做任何事。
+	 */
+	void hashIndexInsert(Node* node);
+	void hashIndexErase(Node* node);
+	void hashIndexReplace(Node* oldNode, Node* newNode);
+
+	/**
+	 * 在热键缓存中查找。未启用缓存时返回 nullptr.
+	 * 
+	 * @param key 键。
+	 * @param hash 输出键的哈希值，供未命中时 hotKeyCacheRemember 使用。
+	 * @param countLookup 是否记入命中统计。
+	 */
+	Node* hotKeyCacheFind(const KeyType& key, uint64_t& hash, bool countLookup = false);
+
+	/**
+	 * 查找成功后记入热键缓存；节点摘下或被搬迁时同步缓存。未启用缓存时不做任何事。
+	 */
+	void hotKeyCacheRemember(uint64_t hash, Node* node);
+	void hotKeyCacheErase(Node* node);
+	void hotKeyCacheReplace(Node* oldNode, Node* newNode);
+
+	/**
+	 * 析构子树中的所有节点，但不把内存还给内存池（之后整体归还）。
+	 * 不使用递归：不断右旋把左孩子提上来，没有左孩子时析构当前节点并转向右子树。
+	 * 节点不需要析构时直接返回。
+	 * 
+	 * @param node 子树的根。可以为 nullptr.
+	 */
+	static void cleanup(Node* node);
+
+	/**
+	 * 析构子树中的所有节点，并归还内存池的所有内存块。
+	 * 
+	 * @param node 子树的根。
+	 * @param pool 子树所在的内存池。
+	 */
+	static void destroyDetachedNodes(Node* node, RedBlackTreeNodePool<Node>& pool);
+
+	/**
+	 * 把所有节点及其内存整体摘下，交给后台线程释放。
+	 * 
+	 * @param detached 是否分离线程（析构时使用）。否则记入 reclaimThread.
+	 * @exception 无法创建线程时抛出，此时树不变。
+	 */
+	void reclaimInBackground(bool detached);
+
+	/**
+	 * 清空除节点外的所有状态：根、最值、整理游标、哈希索引与热键缓存。
+	 */
+	void resetState();
 
 	/**
 	 * 左旋。
@@ -118,4 +694,53 @@ private:
 	 */
 	Node* root = nullptr;
 
+	/**
+	 * 节点的内存池。
+	 */
+	RedBlackTreeNodePool<Node> nodePool;
+
+	/**
+	 * 键类型是否支持哈希索引（std::hash<KeyType> 是否可用）。
+	 * 不支持时，与索引相关的代码不会被实例化。
+	 */
+	static constexpr bool HASH_INDEX_SUPPORTED = 
+		std::is_default_constructible<std::hash<KeyType>>::value;
+
+	/**
+	 * 哈希索引。未启用时为 nullptr.
+	 */
+	std::unique_ptr<RedBlackTreeHashIndex<KeyType, Node>> hashIndex;
+
+	/**
+	 * 热键缓存。未启用时为 nullptr.
+	 */
+	std::unique_ptr<RedBlackTreeHotKeyCache<KeyType, Node>> hotKeyCache;
+
+	/**
+	 * 缓存的最左（键最小）与最右（键最大）节点。树为空时为 nullptr.
+	 * 旋转不改变中序顺序，因此只需在挂上与摘下节点时维护。
+	 */
+	Node* leftmostNode = nullptr;
+	Node* rightmostNode = nullptr;
+
+	/**
+	 * 是否正在进行一轮内存布局整理。
+	 */
+	bool compactionInProgress = false;
+
+	/**
+	 * 内存布局整理下一个要访问的节点。为 nullptr 时本轮整理已访问完所有节点。
+	 */
+	Node* compactionCursor = nullptr;
+
+	/**
+	 * 异步清空使用的后台线程。
+	 */
+	std::thread reclaimThread;
+
+	/**
+	 * 是否延迟析构。
+	 */
+	bool deferredDestruction = false;
+
 };
@@ -5,9 +5,59 @@
  * at Yushan County, Shangrao, Jiangxi
  */
 
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <new>
 #include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
 
 #include "RedBlackTree.h"
+#include "RedBlackTreeHashIndex.hpp"
+#include "RedBlackTreeHotKeyCache.hpp"
+#include "RedBlackTreeKeyPrefix.hpp"
+#include "RedBlackTreeNodePool.hpp"
+#include "WorkStealingThreadPool.hpp"
+
+inline void RedBlackTreeReclaimWorkers::enter()
+{
+	State& state = RedBlackTreeReclaimWorkers::state();
+	std::lock_guard<std::mutex> lock(state.mutex);
+	state.count++;
+}
+
+inline void RedBlackTreeReclaimWorkers::cancel()
+{
+	State& state = RedBlackTreeReclaimWorkers::state();
+	std::lock_guard<std::mutex> lock(state.mutex);
+	state.count--;
+	state.condition.notify_all();
+}
+
+inline void RedBlackTreeReclaimWorkers::leaveAtThreadExit()
+{
+	// 锁一直持有到线程退出，等待者在那之前无法看到计数归零。
+	State& state = RedBlackTreeReclaimWorkers::state();
+	std::unique_lock<std::mutex> lock(state.mutex);
+	state.count--;
+	std::notify_all_at_thread_exit(state.condition, std::move(lock));
+}
+
+inline void RedBlackTreeReclaimWorkers::waitAll()
+{
+	State& state = RedBlackTreeReclaimWorkers::state();
+	std::unique_lock<std::mutex> lock(state.mutex);
+	state.condition.wait(lock, [&state] { return state.count == 0; });
+}
+
+inline RedBlackTreeReclaimWorkers::State& RedBlackTreeReclaimWorkers::state()
+{
+	static State* state = new State;
+	return *state;
+}
 
 template<typename KeyType, typename DataType>
 RedBlackTree<KeyType, DataType>::RedBlackTree()
@@ -17,58 +67,83 @@ RedBlackTree<KeyType, DataType>::RedBlackTree()
 template<typename KeyType, typename DataType>
 RedBlackTree<KeyType, DataType>::~RedBlackTree()
 {
-	if (this->root != nullptr) {
-		this->cleanup(this->root);
-		this->root = nullptr;
+	if (this->deferredDestruction) {
+		if (this->reclaimThread.joinable()) {
+			this->reclaimThread.detach(); // 已登记，可由 waitForDeferredDestruction 等待。
+		}
+
+		if (this->root != nullptr) {
+			try {
+				this->reclaimInBackground(true);
+			}
+			catch (...) {
+				// 无法创建线程。下面同步释放。
+			}
+		}
 	}
+	else if (this->reclaimThread.joinable()) {
+		this->reclaimThread.join();
+	}
+
+	cleanup(this->root);
+	this->root = nullptr;
 }
 
 template<typename KeyType, typename DataType>
 void RedBlackTree<KeyType, DataType>::clear()
 {
-	if (this->root != nullptr) {
-		this->cleanup(this->root);
-		this->root = nullptr;
-	}
+	cleanup(this->root);
+	this->nodePool.releaseAll();
+	this->resetState();
 }
 
 template<typename KeyType, typename DataType>
-bool RedBlackTree<KeyType, DataType>::hasKey(const KeyType& queryKey)
+void RedBlackTree<KeyType, DataType>::clearAsync()
 {
-	Node* currentNode = this->root;
-	
-	while (currentNode != nullptr) {
-		if (queryKey == currentNode->key) {
-			return true; // 找到对应键。
-		}
-		else if (queryKey < currentNode->key) {
-			currentNode = currentNode->leftChild; // 目标键小于当前键，向左查找。
-		}
-		else { // queryKey > currentNode->key
-			currentNode = currentNode->rightChild; // 目标键大于当前键，向右查找。
-		}
+	if (this->reclaimThread.joinable()) {
+		this->reclaimThread.join();
+	}
+
+	if (this->root == nullptr) {
+		this->clear();
+		return;
+	}
+
+	try {
+		this->reclaimInBackground(false);
+	}
+	catch (...) {
+		this->clear(); // 无法创建线程，同步清空。
 	}
+}
+
+template<typename KeyType, typename DataType>
+void RedBlackTree<KeyType, DataType>::setDeferredDestruction(bool enabled)
+{
+	this->deferredDestruction = enabled;
+}
+
+template<typename KeyType, typename DataType>
+void RedBlackTree<KeyType, DataType>::waitForDeferredDestruction()
+{
+	RedBlackTreeReclaimWorkers::waitAll();
+}
 
-	return false; // 找不到键。
+template<typename KeyType, typename DataType>
+bool RedBlackTree<KeyType, DataType>::hasKey(const KeyType& queryKey)
+{
+	return this->findNode(queryKey, true) != nullptr;
 }
 
 template<typename KeyType, typename DataType>
 DataType& RedBlackTree<KeyType, DataType>::getData(const KeyType& key)
 {
-	Node* currentNode = root;
-	while (currentNode != nullptr) {
-		if (key == currentNode->key) {
-			return currentNode->data; // 找到对应键。
-		}
-		else if (key < currentNode->key) {
-			currentNode = currentNode->leftChild; // 目标键小于当前键，向左查找。
-		}
-		else { // key > currentNode->key
-			currentNode = currentNode->rightChild; // 目标键大于当前键，向右查找。
-		}
+	Node* targetNode = this->findNode(key, true);
+	if (targetNode == nullptr) {
+		throw std::runtime_error("could not find your key in the object."); // 找不到对应键。抛出异常。
 	}
 
-	throw std::runtime_error("could not find your key in the object."); // 找不到对应键。抛出异常。
+	return targetNode->data;
 }
 
 template<typename KeyType, typename DataType>
@@ -77,80 +152,291 @@ RedBlackTree<KeyType, DataType>& RedBlackTree<KeyType, DataType>::setData(
 	const DataType& data
 )
 {
-	Node* currentNode = root;
-	Node* currentFather = nullptr;
+	bool created;
+	Node* targetNode = this->findOrCreateNode(key, created);
+	targetNode->data = data;
+	return *this;
+}
+
+template<typename KeyType, typename DataType>
+RedBlackTree<KeyType, DataType>& RedBlackTree<KeyType, DataType>::removeKey(
+	const KeyType& key
+)
+{
+	Node* targetNode = this->findNode(key);
+
+	if (targetNode == nullptr) {
+		throw std::runtime_error("could not find your key in the object."); // 找不到对应键。抛出异常。
+	}
+
+	this->detachNode(targetNode);
+	this->destroyNode(targetNode);
+	return *this;
+}
+
+template<typename KeyType, typename DataType>
+bool RedBlackTree<KeyType, DataType>::isEmpty() const
+{
+	return this->root == nullptr;
+}
+
+template<typename KeyType, typename DataType>
+typename RedBlackTree<KeyType, DataType>::Handle RedBlackTree<KeyType, DataType>::getHandle(
+	const KeyType& key
+)
+{
+	Node* targetNode = this->findNode(key, true);
+	if (targetNode == nullptr) {
+		throw std::runtime_error("could not find your key in the object."); // 找不到对应键。抛出异常。
+	}
+
+	return Handle(targetNode);
+}
+
+template<typename KeyType, typename DataType>
+typename RedBlackTree<KeyType, DataType>::Handle RedBlackTree<KeyType, DataType>::lowerBound(
+	const KeyType& key
+)
+{
+	Node* currentNode = this->root;
+	Node* candidateNode = nullptr;
+
+	KeyPrefix keyPrefix;
+	keyPrefix.setKeyPrefix(key);
 
 	while (currentNode != nullptr) {
-		if (key == currentNode->key) { // 找到对应键。
-			currentNode->data = data;
-			return *this; // 更新完成。结束。
+		int comparison = KeyPrefix::compareKeys(key, keyPrefix, currentNode->key, *currentNode);
+		if (comparison == 0) {
+			return Handle(currentNode);
+		}
+		else if (comparison < 0) {
+			candidateNode = currentNode; // 当前键大于 key，是候选；继续向左找更小的。
+			currentNode = currentNode->leftChild;
 		}
 		else {
-			currentFather = currentNode;
-			currentNode = (key < currentNode->key ? currentNode->leftChild : currentNode->rightChild);
+			currentNode = currentNode->rightChild;
 		}
 	}
 
-	// 如果是更新现有键值，则在上面的循环里会触发 return.
-	// 下面部分负责创建新的节点，完成新数据的存储。
+	return Handle(candidateNode);
+}
 
-	/*
-		此时，currentNode 指向 nullptr, currentFather 指向最后遍历到的节点，也可能是 nullptr.
-		插入时，新节点设为红色，根据键值插入到最后一个节点的左或右。
-	*/
+template<typename KeyType, typename DataType>
+template<typename Factory>
+DataType& RedBlackTree<KeyType, DataType>::getOrInsert(const KeyType& key, Factory&& factory)
+{
+	Node* father;
+	Node* targetNode = this->findNodeOrInsertionPoint(nullptr, key, father);
+	if (targetNode != nullptr) {
+		return targetNode->data;
+	}
 
-	// 创建新节点。
-	currentNode = new Node;
-	currentNode->father = currentFather;
-	currentNode->leftChild = nullptr;
-	currentNode->rightChild = nullptr;
-	currentNode->key = key;
-	currentNode->data = data;
+	targetNode = this->createNode(key, std::forward<Factory>(factory));
+	try {
+		this->attachNode(targetNode, father);
+	}
+	catch (...) {
+		this->destroyNode(targetNode);
+		throw;
+	}
+	return targetNode->data;
+}
 
-	// 如果树是空的，插入节点设为根即可。
-	if (currentFather == nullptr) {
-		currentNode->color = NodeColor::BLACK;
-		this->root = currentNode;
-		return *this;
+template<typename KeyType, typename DataType>
+template<typename Function>
+DataType& RedBlackTree<KeyType, DataType>::upsert(const KeyType& key, Function&& function)
+{
+	Node* father;
+	Node* targetNode = this->findNodeOrInsertionPoint(nullptr, key, father);
+	if (targetNode != nullptr) {
+		function(targetNode->data);
+		return targetNode->data;
 	}
 
-	// 下面处理树是非空时的情况。
-	// 先将节点设为红色。
-	currentNode->color = NodeColor::RED;
-	// 将新节点绑定到父节点。
-	if (key < currentFather->key) {
-		currentFather->leftChild = currentNode;
+	targetNode = this->createNode(key, [] { return DataType(); });
+	try {
+		this->attachNode(targetNode, father);
+	}
+	catch (...) {
+		this->destroyNode(targetNode);
+		throw;
+	}
+
+	try {
+		function(targetNode->data);
+	}
+	catch (...) {
+		this->detachNode(targetNode);
+		this->destroyNode(targetNode);
+		throw;
+	}
+	return targetNode->data;
+}
+
+template<typename KeyType, typename DataType>
+template<typename Function>
+bool RedBlackTree<KeyType, DataType>::computeIfPresent(const KeyType& key, Function&& function)
+{
+	Node* targetNode = this->findNode(key);
+	if (targetNode == nullptr) {
+		return false;
+	}
+
+	if constexpr (std::is_same<decltype(function(targetNode->data)), bool>::value) {
+		if (!function(targetNode->data)) {
+			this->detachNode(targetNode);
+			this->destroyNode(targetNode);
+		}
 	}
 	else {
-		currentFather->rightChild = currentNode;
+		function(targetNode->data);
 	}
+	return true;
+}
 
-	// 对可能出现的“连续红色节点”问题进行修复。
-	this->fixContinuousRedNodeProblem(currentNode);
-	return *this;
+template<typename KeyType, typename DataType>
+typename RedBlackTree<KeyType, DataType>::Handle RedBlackTree<KeyType, DataType>::min()
+{
+	if (this->leftmostNode == nullptr) {
+		throw std::runtime_error("the object is empty.");
+	}
+
+	return Handle(this->leftmostNode);
 }
 
 template<typename KeyType, typename DataType>
-RedBlackTree<KeyType, DataType>& RedBlackTree<KeyType, DataType>::removeKey(
-	const KeyType& key
+typename RedBlackTree<KeyType, DataType>::Handle RedBlackTree<KeyType, DataType>::max()
+{
+	if (this->rightmostNode == nullptr) {
+		throw std::runtime_error("the object is empty.");
+	}
+
+	return Handle(this->rightmostNode);
+}
+
+template<typename KeyType, typename DataType>
+std::pair<KeyType, DataType> RedBlackTree<KeyType, DataType>::popMin()
+{
+	if (this->leftmostNode == nullptr) {
+		throw std::runtime_error("the object is empty.");
+	}
+
+	return this->popNode(this->leftmostNode);
+}
+
+template<typename KeyType, typename DataType>
+std::pair<KeyType, DataType> RedBlackTree<KeyType, DataType>::popMax()
+{
+	if (this->rightmostNode == nullptr) {
+		throw std::runtime_error("the object is empty.");
+	}
+
+	return this->popNode(this->rightmostNode);
+}
+
+template<typename KeyType, typename DataType>
+RedBlackTree<KeyType, DataType>& RedBlackTree<KeyType, DataType>::rekey(
+	const Handle& handle,
+	const KeyType& newKey
 )
 {
-	Node* currentNode = root;
+	Node* targetNode = handle.node;
+	if (targetNode == nullptr) {
+		throw std::runtime_error("the handle is empty.");
+	}
+
+	if (newKey == targetNode->key) {
+		return *this;
+	}
+
+	if (this->findNode(newKey) != nullptr) {
+		throw std::runtime_error("the new key already exists in the object.");
+	}
+
+	// 先复制新键，避免摘下节点后复制失败，节点无处可去。
+	KeyType keyCopy = newKey;
 
+	this->detachNode(targetNode);
+	targetNode->key = std::move(keyCopy);
+	targetNode->setKeyPrefix(targetNode->key);
+
+	// 重新下降，找到新键的插入位置。前面已经确认新键不在树上。
+	Node* currentNode = this->root;
+	Node* currentFather = nullptr;
 	while (currentNode != nullptr) {
-		if (key == currentNode->key) {
-			break; // 键匹配，查询成功。
-		}
-		else {
-			currentNode = (key < currentNode->key ? currentNode->leftChild : currentNode->rightChild);
-		}
+		currentFather = currentNode;
+		currentNode = (
+			KeyPrefix::compareKeys(targetNode->key, *targetNode, currentNode->key, *currentNode) < 0
+				? currentNode->leftChild : currentNode->rightChild
+		);
 	}
 
-	if (currentNode == nullptr) {
-		throw std::runtime_error("could not find your key in the object."); // 找不到对应键。抛出异常。
+	this->attachNode(targetNode, currentFather);
+	return *this;
+}
+
+template<typename KeyType, typename DataType>
+const KeyType& RedBlackTree<KeyType, DataType>::Handle::key() const
+{
+	return this->node->key;
+}
+
+template<typename KeyType, typename DataType>
+DataType& RedBlackTree<KeyType, DataType>::Handle::data() const
+{
+	return this->node->data;
+}
+
+template<typename KeyType, typename DataType>
+bool RedBlackTree<KeyType, DataType>::Handle::isValid() const
+{
+	return this->node != nullptr;
+}
+
+template<typename KeyType, typename DataType>
+typename RedBlackTree<KeyType, DataType>::Handle RedBlackTree<KeyType, DataType>::Handle::next() const
+{
+	return Handle(successorOf(this->node));
+}
+
+template<typename KeyType, typename DataType>
+std::pair<KeyType, DataType> RedBlackTree<KeyType, DataType>::popNode(Node* node)
+{
+	// 最左（最右）节点至多有一个右（左）孩子，摘下时替代法最多交换一次，不需要查找。
+	this->detachNode(node);
+
+	std::pair<KeyType, DataType> result;
+	try {
+		result.first = std::move(node->key);
+		result.second = std::move(node->data);
+	}
+	catch (...) {
+		this->destroyNode(node);
+		throw;
 	}
 
-	// 否则，使用替代法，锁定替代的节点。
+	this->destroyNode(node);
+	return result;
+}
+
+template<typename KeyType, typename DataType>
+void RedBlackTree<KeyType, DataType>::detachNode(Node* currentNode)
+{
+	// 整理内存布局的游标与缓存的最值不能停在将被摘下的节点上。
+	// 下面的替代法交换的是节点本身而不是键和数据，后继与前驱节点在摘下后依然有效。
+	if (currentNode == this->compactionCursor) {
+		this->compactionCursor = successorOf(currentNode);
+	}
+	if (currentNode == this->leftmostNode) {
+		this->leftmostNode = successorOf(currentNode);
+	}
+	if (currentNode == this->rightmostNode) {
+		this->rightmostNode = predecessorOf(currentNode);
+	}
+	this->hashIndexErase(currentNode);
+	this->hotKeyCacheErase(currentNode);
+
+	// 使用替代法，锁定替代的节点。
 	// 只要有至少一个孩子，就要继续寻找替代节点。
 	while (currentNode->leftChild != nullptr || currentNode->rightChild != nullptr) {
 		if (currentNode->rightChild != nullptr) {
@@ -302,7 +588,6 @@ RedBlackTree<KeyType, DataType>& RedBlackTree<KeyType, DataType>::removeKey(
 
 	if (currentNode == this->root) { // 删除的是根。
 		this->root = nullptr;
-		delete currentNode;
 	} // 删除的是根。
 	else if (currentNode->color == NodeColor::RED) {
 		if (currentNode == currentNode->father->leftChild) {
@@ -311,7 +596,6 @@ RedBlackTree<KeyType, DataType>& RedBlackTree<KeyType, DataType>::removeKey(
 		else {
 			currentNode->father->rightChild = nullptr;
 		}
-		delete currentNode;
 	} // 要删除的是红色的叶节点。
 	else { // 要删除的是黑色的叶节点。
 		// 目标节点的父节点一定存在。因为目标节点是黑色的，所以兄弟一定存在。
@@ -323,7 +607,7 @@ RedBlackTree<KeyType, DataType>& RedBlackTree<KeyType, DataType>::removeKey(
 		ChildSide siblingSideToFather = 
 			(sibling == currentFather->leftChild ? ChildSide::LEFT : ChildSide::RIGHT);
 
-		// 前面已经找完了与删除目标相关的节点。现在可以删掉目标节点了。
+		// 前面已经找完了与删除目标相关的节点。现在可以摘下目标节点了。
 		// 取消父节点对它的绑定。
 		if (currentFather->leftChild == currentNode) {
 			currentFather->leftChild = nullptr;
@@ -331,8 +615,6 @@ RedBlackTree<KeyType, DataType>& RedBlackTree<KeyType, DataType>::removeKey(
 		else {
 			currentFather->rightChild = nullptr;
 		}
-		// 释放节点。
-		delete currentNode;
 
 		// 接下来开始分情况讨论。
 
@@ -570,19 +852,821 @@ RedBlackTree<KeyType, DataType>& RedBlackTree<KeyType, DataType>::removeKey(
 		}
 	}
 
-	return *this; // 删除成功。
+	currentNode->father = nullptr;
+	currentNode->leftChild = nullptr;
+	currentNode->rightChild = nullptr;
 }
 
 template<typename KeyType, typename DataType>
-void RedBlackTree<KeyType, DataType>::cleanup(Node* node)
+template<typename Function>
+void RedBlackTree<KeyType, DataType>::forEach(Function&& function)
 {
-	if (node->leftChild != nullptr) {
-		cleanup(node->leftChild);
+	forEachNodeInSubtree(this->root, [&function] (Node* node) {
+		function(static_cast<const KeyType&>(node->key), node->data);
+	});
+}
+
+template<typename KeyType, typename DataType>
+template<typename Function>
+void RedBlackTree<KeyType, DataType>::parallelForEach(
+	Function&& function, 
+	WorkStealingThreadPool& pool
+)
+{
+	if (this->root == nullptr) {
+		return;
 	}
-	if (node->rightChild != nullptr) {
-		cleanup(node->rightChild);
+
+	unsigned cutoffDepth = parallelCutoffDepth(pool);
+
+	// 按深度拆分子树。左子树交给线程池，当前线程继续处理节点本身和右子树。
+	std::function<void(Node*, unsigned)> visitSubtree = [&] (Node* subtreeRoot, unsigned depth) {
+		if (depth >= cutoffDepth) {
+			forEachNodeInSubtree(subtreeRoot, [&function] (Node* node) {
+				function(static_cast<const KeyType&>(node->key), node->data);
+			});
+			return;
+		}
+
+		WorkStealingThreadPool::TaskGroup group;
+		if (subtreeRoot->leftChild != nullptr) {
+			Node* leftChild = subtreeRoot->leftChild;
+			pool.submit(group, [&visitSubtree, leftChild, depth] {
+				visitSubtree(leftChild, depth + 1);
+			});
+		}
+
+		// 即使当前线程出了异常，也要等子任务结束，它们引用了本栈帧的变量。
+		try {
+			function(static_cast<const KeyType&>(subtreeRoot->key), subtreeRoot->data);
+			if (subtreeRoot->rightChild != nullptr) {
+				visitSubtree(subtreeRoot->rightChild, depth + 1);
+			}
+		}
+		catch (...) {
+			try {
+				pool.wait(group);
+			}
+			catch (...) {
+			}
+			throw;
+		}
+
+		pool.wait(group);
+	};
+
+	visitSubtree(this->root, 0);
+}
+
+template<typename KeyType, typename DataType>
+template<typename Function>
+void RedBlackTree<KeyType, DataType>::parallelForEach(Function&& function)
+{
+	WorkStealingThreadPool pool;
+	this->parallelForEach(std::forward<Function>(function), pool);
+}
+
+template<typename KeyType, typename DataType>
+template<typename ResultType, typename MapFunction, typename CombineFunction>
+ResultType RedBlackTree<KeyType, DataType>::parallelReduce(
+	const ResultType& identity,
+	MapFunction&& map,
+	CombineFunction&& combine,
+	WorkStealingThreadPool& pool
+)
+{
+	if (this->root == nullptr) {
+		return identity;
+	}
+
+	unsigned cutoffDepth = parallelCutoffDepth(pool);
+
+	// 返回非空子树按中序合并的结果。空子树不参与合并。
+	std::function<ResultType(Node*, unsigned)> reduceSubtree = [&] (Node* subtreeRoot, unsigned depth) {
+		if (depth >= cutoffDepth) {
+			ResultType result = identity;
+			bool empty = true;
+			forEachNodeInSubtree(subtreeRoot, [&] (Node* node) {
+				ResultType mapped = map(static_cast<const KeyType&>(node->key), node->data);
+				if (empty) {
+					result = std::move(mapped);
+					empty = false;
+				}
+				else {
+					result = combine(result, mapped);
+				}
+			});
+			return result;
+		}
+
+		WorkStealingThreadPool::TaskGroup group;
+		ResultType leftResult = identity;
+		if (subtreeRoot->leftChild != nullptr) {
+			Node* leftChild = subtreeRoot->leftChild;
+			pool.submit(group, [&reduceSubtree, &leftResult, leftChild, depth] {
+				leftResult = reduceSubtree(leftChild, depth + 1);
+			});
+		}
+
+		ResultType result = identity;
+		try {
+			result = map(static_cast<const KeyType&>(subtreeRoot->key), subtreeRoot->data);
+			if (subtreeRoot->rightChild != nullptr) {
+				result = combine(result, reduceSubtree(subtreeRoot->rightChild, depth + 1));
+			}
+		}
+		catch (...) {
+			try {
+				pool.wait(group);
+			}
+			catch (...) {
+			}
+			throw;
+		}
+
+		pool.wait(group);
+
+		if (subtreeRoot->leftChild != nullptr) {
+			result = combine(leftResult, result);
+		}
+		return result;
+	};
+
+	return combine(identity, reduceSubtree(this->root, 0));
+}
+
+template<typename KeyType, typename DataType>
+template<typename ResultType, typename MapFunction, typename CombineFunction>
+ResultType RedBlackTree<KeyType, DataType>::parallelReduce(
+	const ResultType& identity,
+	MapFunction&& map,
+	CombineFunction&& combine
+)
+{
+	WorkStealingThreadPool pool;
+	return this->parallelReduce(
+		identity, 
+		std::forward<MapFunction>(map), 
+		std::forward<CombineFunction>(combine), 
+		pool
+	);
+}
+
+template<typename KeyType, typename DataType>
+bool RedBlackTree<KeyType, DataType>::compactLayout(size_t budget)
+{
+	if (!this->compactionInProgress) {
+		if (this->root == nullptr) {
+			return true;
+		}
+
+		// 开始新的一轮：现有的块全部退役，从最小的键开始搬迁。
+		this->nodePool.retireAll();
+		this->compactionInProgress = true;
+		this->compactionCursor = this->root;
+		while (this->compactionCursor->leftChild != nullptr) {
+			this->compactionCursor = this->compactionCursor->leftChild;
+		}
+	}
+
+	while (budget > 0 && this->compactionCursor != nullptr) {
+		// 搬迁不改变树的结构，可以先求后继。
+		Node* nextNode = successorOf(this->compactionCursor);
+		if (this->nodePool.isRetired(this->compactionCursor)) {
+			this->relocateNode(this->compactionCursor);
+		}
+
+		this->compactionCursor = nextNode;
+		budget--;
+	}
+
+	if (this->compactionCursor == nullptr) {
+		// 游标之前的节点要么已经搬走，要么是整理开始后新建的，退役的块都已归还。
+		this->compactionInProgress = false;
+		return true;
+	}
+
+	return false;
+}
+
+template<typename KeyType, typename DataType>
+void RedBlackTree<KeyType, DataType>::enableHashIndex()
+{
+	static_assert(HASH_INDEX_SUPPORTED, "hash index requires std::hash<KeyType>.");
+
+	if (this->hashIndex != nullptr) {
+		return;
+	}
+
+	std::unique_ptr<RedBlackTreeHashIndex<KeyType, Node>> newIndex(
+		new RedBlackTreeHashIndex<KeyType, Node>
+	);
+	forEachNodeInSubtree(this->root, [&newIndex] (Node* node) {
+		newIndex->insert(node);
+	});
+
+	this->hashIndex = std::move(newIndex);
+}
+
+template<typename KeyType, typename DataType>
+void RedBlackTree<KeyType, DataType>::disableHashIndex()
+{
+	this->hashIndex.reset();
+}
+
+template<typename KeyType, typename DataType>
+bool RedBlackTree<KeyType, DataType>::isHashIndexEnabled() const
+{
+	return this->hashIndex != nullptr;
+}
+
+template<typename KeyType, typename DataType>
+size_t RedBlackTree<KeyType, DataType>::getHashIndexMemoryUsage() const
+{
+	return this->hashIndex != nullptr ? this->hashIndex->getMemoryUsage() : 0;
+}
+
+template<typename KeyType, typename DataType>
+void RedBlackTree<KeyType, DataType>::enableHotKeyCache(size_t capacity)
+{
+	static_assert(HASH_INDEX_SUPPORTED, "hot key cache requires std::hash<KeyType>.");
+
+	this->hotKeyCache.reset(new RedBlackTreeHotKeyCache<KeyType, Node>(capacity));
+}
+
+template<typename KeyType, typename DataType>
+void RedBlackTree<KeyType, DataType>::disableHotKeyCache()
+{
+	this->hotKeyCache.reset();
+}
+
+template<typename KeyType, typename DataType>
+bool RedBlackTree<KeyType, DataType>::isHotKeyCacheEnabled() const
+{
+	return this->hotKeyCache != nullptr;
+}
+
+template<typename KeyType, typename DataType>
+size_t RedBlackTree<KeyType, DataType>::getHotKeyCacheHitCount() const
+{
+	return this->hotKeyCache != nullptr ? this->hotKeyCache->getHitCount() : 0;
+}
+
+template<typename KeyType, typename DataType>
+size_t RedBlackTree<KeyType, DataType>::getHotKeyCacheMissCount() const
+{
+	return this->hotKeyCache != nullptr ? this->hotKeyCache->getMissCount() : 0;
+}
+
+template<typename KeyType, typename DataType>
+void RedBlackTree<KeyType, DataType>::hashIndexInsert(Node* node)
+{
+	if constexpr (HASH_INDEX_SUPPORTED) {
+		if (this->hashIndex != nullptr) {
+			this->hashIndex->insert(node);
+		}
+	}
+}
+
+template<typename KeyType, typename DataType>
+void RedBlackTree<KeyType, DataType>::hashIndexErase(Node* node)
+{
+	if constexpr (HASH_INDEX_SUPPORTED) {
+		if (this->hashIndex != nullptr) {
+			this->hashIndex->erase(node);
+		}
+	}
+}
+
+template<typename KeyType, typename DataType>
+void RedBlackTree<KeyType, DataType>::hashIndexReplace(Node* oldNode, Node* newNode)
+{
+	if constexpr (HASH_INDEX_SUPPORTED) {
+		if (this->hashIndex != nullptr) {
+			this->hashIndex->replace(oldNode, newNode);
+		}
+	}
+}
+
+template<typename KeyType, typename DataType>
+typename RedBlackTree<KeyType, DataType>::Node* RedBlackTree<KeyType, DataType>::hotKeyCacheFind(
+	const KeyType& key,
+	uint64_t& hash,
+	bool countLookup
+)
+{
+	if constexpr (HASH_INDEX_SUPPORTED) {
+		if (this->hotKeyCache != nullptr) {
+			hash = RedBlackTreeHashIndex<KeyType, Node>::hashOf(key);
+			Node* cachedNode = this->hotKeyCache->find(key, hash);
+			if (countLookup) {
+				this->hotKeyCache->countLookup(cachedNode != nullptr);
+			}
+			return cachedNode;
+		}
+	}
+
+	return nullptr;
+}
+
+template<typename KeyType, typename DataType>
+void RedBlackTree<KeyType, DataType>::hotKeyCacheRemember(uint64_t hash, Node* node)
+{
+	if (this->hotKeyCache != nullptr) {
+		this->hotKeyCache->remember(hash, node);
+	}
+}
+
+template<typename KeyType, typename DataType>
+void RedBlackTree<KeyType, DataType>::hotKeyCacheErase(Node* node)
+{
+	if constexpr (HASH_INDEX_SUPPORTED) {
+		if (this->hotKeyCache != nullptr) {
+			this->hotKeyCache->erase(node);
+		}
+	}
+}
+
+template<typename KeyType, typename DataType>
+void RedBlackTree<KeyType, DataType>::hotKeyCacheReplace(Node* oldNode, Node* newNode)
+{
+	if constexpr (HASH_INDEX_SUPPORTED) {
+		if (this->hotKeyCache != nullptr) {
+			this->hotKeyCache->replace(oldNode, newNode);
+		}
+	}
+}
+
+template<typename KeyType, typename DataType>
+template<typename Function>
+void RedBlackTree<KeyType, DataType>::forEachNodeInSubtree(Node* subtreeRoot, Function&& function)
+{
+	if (subtreeRoot == nullptr) {
+		return;
+	}
+
+	Node* currentNode = subtreeRoot;
+
+	// 先走到最左侧的节点。
+	while (currentNode->leftChild != nullptr) {
+		currentNode = currentNode->leftChild;
+	}
+
+	while (currentNode != nullptr) {
+		// 先求后继，允许访问函数修改当前节点的数据。
+		Node* nextNode;
+		if (currentNode->rightChild != nullptr) {
+			nextNode = currentNode->rightChild;
+			while (nextNode->leftChild != nullptr) {
+				nextNode = nextNode->leftChild;
+			}
+		}
+		else {
+			// 向上回溯，直到从左侧离开某个节点。到达子树的根就结束，不离开子树。
+			Node* childNode = currentNode;
+			nextNode = nullptr;
+			while (childNode != subtreeRoot) {
+				Node* currentFather = childNode->father;
+				if (currentFather->leftChild == childNode) {
+					nextNode = currentFather;
+					break;
+				}
+				childNode = currentFather;
+			}
+		}
+
+		function(currentNode);
+		currentNode = nextNode;
+	}
+}
+
+template<typename KeyType, typename DataType>
+unsigned RedBlackTree<KeyType, DataType>::parallelCutoffDepth(const WorkStealingThreadPool& pool)
+{
+	unsigned depth = PARALLEL_SPLIT_SLACK;
+	for (unsigned threadCount = pool.size(); threadCount > 1; threadCount = (threadCount + 1) / 2) {
+		depth++;
+	}
+
+	return depth;
+}
+
+template<typename KeyType, typename DataType>
+typename RedBlackTree<KeyType, DataType>::Node* RedBlackTree<KeyType, DataType>::findNode(
+	const KeyType& key,
+	bool countLookup
+)
+{
+	uint64_t hash = 0;
+	Node* cachedNode = this->hotKeyCacheFind(key, hash, countLookup);
+	if (cachedNode != nullptr) {
+		return cachedNode; // 热键，不必下降。
+	}
+
+	if constexpr (HASH_INDEX_SUPPORTED) {
+		if (this->hashIndex != nullptr) {
+			Node* indexedNode = this->hashIndex->find(key); // 有哈希索引时不必下降。
+			if (indexedNode != nullptr) {
+				this->hotKeyCacheRemember(hash, indexedNode);
+			}
+			return indexedNode;
+		}
+	}
+
+	Node* currentNode = this->root;
+
+	KeyPrefix keyPrefix;
+	keyPrefix.setKeyPrefix(key);
+
+	while (currentNode != nullptr) {
+		int comparison = KeyPrefix::compareKeys(key, keyPrefix, currentNode->key, *currentNode);
+		if (comparison == 0) {
+			this->hotKeyCacheRemember(hash, currentNode);
+			return currentNode; // 找到对应键。
+		}
+		else if (comparison < 0) {
+			currentNode = currentNode->leftChild; // 目标键小于当前键，向左查找。
+		}
+		else { // key > currentNode->key
+			currentNode = currentNode->rightChild; // 目标键大于当前键，向右查找。
+		}
+	}
+
+	return nullptr; // 找不到键。
+}
+
+template<typename KeyType, typename DataType>
+typename RedBlackTree<KeyType, DataType>::Node* RedBlackTree<KeyType, DataType>::findOrCreateNode(
+	const KeyType& key,
+	bool& created
+)
+{
+	return this->findOrCreateNodeNear(nullptr, key, created);
+}
+
+template<typename KeyType, typename DataType>
+typename RedBlackTree<KeyType, DataType>::Node* RedBlackTree<KeyType, DataType>::findOrCreateNodeNear(
+	Node* hint,
+	const KeyType& key,
+	bool& created
+)
+{
+	Node* father;
+	Node* existingNode = this->findNodeOrInsertionPoint(hint, key, father);
+	if (existingNode != nullptr) {
+		created = false;
+		return existingNode;
+	}
+
+	/*
+		此时，father 指向最后遍历到的节点，也可能是 nullptr.
+		插入时，新节点设为红色，根据键值插入到最后一个节点的左或右。
+	*/
+
+	// 创建新节点。
+	created = true;
+	Node* newNode = this->createNode();
+	try {
+		newNode->key = key;
+		newNode->setKeyPrefix(newNode->key);
+		this->attachNode(newNode, father);
+	}
+	catch (...) {
+		this->destroyNode(newNode);
+		throw;
+	}
+	return newNode;
+}
+
+template<typename KeyType, typename DataType>
+typename RedBlackTree<KeyType, DataType>::Node* RedBlackTree<KeyType, DataType>::findNodeOrInsertionPoint(
+	Node* hint,
+	const KeyType& key,
+	Node*& father
+)
+{
+	father = nullptr;
+
+	// 只查不记：批量插入的新键不应把热键挤出缓存。
+	uint64_t hash = 0;
+	Node* cachedNode = this->hotKeyCacheFind(key, hash);
+	if (cachedNode != nullptr) {
+		return cachedNode;
+	}
+
+	if constexpr (HASH_INDEX_SUPPORTED) {
+		if (this->hashIndex != nullptr) {
+			// 键已存在时直接返回；否则下降只是为了找到插入位置。
+			Node* existingNode = this->hashIndex->find(key);
+			if (existingNode != nullptr) {
+				return existingNode;
+			}
+		}
+	}
+
+	Node* currentNode = this->root;
+
+	KeyPrefix keyPrefix;
+	keyPrefix.setKeyPrefix(key);
+
+	if (hint != nullptr && KeyPrefix::compareKeys(key, keyPrefix, hint->key, *hint) > 0) {
+		// 从提示节点向上回溯。路径上的节点都小于 key;
+		// 停在第一个父节点大于 key 的节点处时，key 一定落在该节点的子树范围内。
+		currentNode = hint;
+		while (currentNode->father != nullptr) {
+			Node* currentFather = currentNode->father;
+			int comparison = KeyPrefix::compareKeys(key, keyPrefix, currentFather->key, *currentFather);
+			if (comparison == 0) {
+				return currentFather;
+			}
+			else if (comparison < 0) {
+				break;
+			}
+
+			currentNode = currentFather;
+		}
+	}
+
+	while (currentNode != nullptr) {
+		int comparison = KeyPrefix::compareKeys(key, keyPrefix, currentNode->key, *currentNode);
+		if (comparison == 0) { // 找到对应键。
+			return currentNode;
+		}
+		else {
+			father = currentNode;
+			currentNode = (comparison < 0 ? currentNode->leftChild : currentNode->rightChild);
+		}
+	}
+
+	return nullptr; // 键不存在。father 为插入位置的父节点。
+}
+
+template<typename KeyType, typename DataType>
+void RedBlackTree<KeyType, DataType>::attachNode(Node* node, Node* father)
+{
+	// 先更新哈希索引。索引扩容失败时树还没有被修改。
+	this->hashIndexInsert(node);
+
+	node->father = father;
+	node->leftChild = nullptr;
+	node->rightChild = nullptr;
+
+	// 如果树是空的，插入节点设为根即可。
+	if (father == nullptr) {
+		node->color = NodeColor::BLACK;
+		this->root = node;
+		this->leftmostNode = node;
+		this->rightmostNode = node;
+		return;
+	}
+
+	// 下面处理树是非空时的情况。
+	// 先将节点设为红色。
+	node->color = NodeColor::RED;
+	// 将新节点绑定到父节点。
+	// 新节点挂在最左节点的左侧，或最右节点的右侧时，它就是新的最值。
+	if (KeyPrefix::compareKeys(node->key, *node, father->key, *father) < 0) {
+		father->leftChild = node;
+		if (father == this->leftmostNode) {
+			this->leftmostNode = node;
+		}
+	}
+	else {
+		father->rightChild = node;
+		if (father == this->rightmostNode) {
+			this->rightmostNode = node;
+		}
+	}
+
+	// 对可能出现的“连续红色节点”问题进行修复。
+	// 修复只做旋转和重新着色，不会改变节点本身与中序顺序，因此节点指针与缓存的最值依然有效。
+	this->fixContinuousRedNodeProblem(node);
+}
+
+template<typename KeyType, typename DataType>
+typename RedBlackTree<KeyType, DataType>::Node* RedBlackTree<KeyType, DataType>::createNode()
+{
+	void* slot = this->nodePool.allocate();
+	try {
+		return new (slot) Node;
+	}
+	catch (...) {
+		this->nodePool.deallocate(slot);
+		throw;
+	}
+}
+
+template<typename KeyType, typename DataType>
+template<typename Factory>
+typename RedBlackTree<KeyType, DataType>::Node* RedBlackTree<KeyType, DataType>::createNode(
+	const KeyType& key,
+	Factory&& factory
+)
+{
+	void* slot = this->nodePool.allocate();
+	Node* node;
+	try {
+		// 数据直接由工厂函数的返回值初始化，键直接拷贝构造，都不经过默认构造再赋值。
+		node = new (slot) Node{ { std::forward<Factory>(factory)() }, KeyPrefix(), key };
+	}
+	catch (...) {
+		this->nodePool.deallocate(slot);
+		throw;
+	}
+
+	node->setKeyPrefix(node->key);
+	return node;
+}
+
+template<typename KeyType, typename DataType>
+void RedBlackTree<KeyType, DataType>::destroyNode(Node* node)
+{
+	node->~Node();
+	this->nodePool.deallocate(node);
+}
+
+template<typename KeyType, typename DataType>
+typename RedBlackTree<KeyType, DataType>::Node* RedBlackTree<KeyType, DataType>::relocateNode(
+	Node* node
+)
+{
+	void* slot = this->nodePool.allocateContiguous();
+	Node* newNode;
+	try {
+		newNode = new (slot) Node(std::move(*node));
+	}
+	catch (...) {
+		this->nodePool.deallocate(slot);
+		throw;
+	}
+
+	// 修正指向该节点的指针。
+	if (node == this->leftmostNode) {
+		this->leftmostNode = newNode;
+	}
+	if (node == this->rightmostNode) {
+		this->rightmostNode = newNode;
+	}
+	if (node->father == nullptr) {
+		this->root = newNode;
+	}
+	else if (node->father->leftChild == node) {
+		node->father->leftChild = newNode;
+	}
+	else {
+		node->father->rightChild = newNode;
+	}
+
+	if (node->leftChild != nullptr) {
+		node->leftChild->father = newNode;
+	}
+	if (node->rightChild != nullptr) {
+		node->rightChild->father = newNode;
+	}
+
+	this->hashIndexReplace(node, newNode);
+	this->hotKeyCacheReplace(node, newNode);
+	this->destroyNode(node);
+	return newNode;
+}
+
+template<typename KeyType, typename DataType>
+typename RedBlackTree<KeyType, DataType>::Node* RedBlackTree<KeyType, DataType>::successorOf(
+	Node* node
+)
+{
+	if (node->rightChild != nullptr) {
+		node = node->rightChild;
+		while (node->leftChild != nullptr) {
+			node = node->leftChild;
+		}
+		return node;
+	}
+
+	// 向上回溯，直到从左侧离开某个节点。
+	Node* currentFather = node->father;
+	while (currentFather != nullptr && currentFather->rightChild == node) {
+		node = currentFather;
+		currentFather = currentFather->father;
+	}
+	return currentFather;
+}
+
+template<typename KeyType, typename DataType>
+typename RedBlackTree<KeyType, DataType>::Node* RedBlackTree<KeyType, DataType>::predecessorOf(
+	Node* node
+)
+{
+	if (node->leftChild != nullptr) {
+		node = node->leftChild;
+		while (node->rightChild != nullptr) {
+			node = node->rightChild;
+		}
+		return node;
+	}
+
+	// 向上回溯，直到从右侧离开某个节点。
+	Node* currentFather = node->father;
+	while (currentFather != nullptr && currentFather->leftChild == node) {
+		node = currentFather;
+		currentFather = currentFather->father;
+	}
+	return currentFather;
+}
+
+template<typename KeyType, typename DataType>
+void RedBlackTree<KeyType, DataType>::cleanup(Node* node)
+{
+	if constexpr (std::is_trivially_destructible<Node>::value) {
+		return; // 内存由内存池整体归还。
+	}
+
+	Node* currentNode = node;
+
+	while (currentNode != nullptr) {
+		if (currentNode->leftChild != nullptr) {
+			// 右旋，把左孩子提上来。父节点指针不再需要，不必维护。
+			Node* leftChild = currentNode->leftChild;
+			currentNode->leftChild = leftChild->rightChild;
+			leftChild->rightChild = currentNode;
+			currentNode = leftChild;
+		}
+		else {
+			// 没有左孩子，析构当前节点，继续处理右子树。
+			Node* rightChild = currentNode->rightChild;
+			currentNode->~Node();
+			currentNode = rightChild;
+		}
+	}
+}
+
+template<typename KeyType, typename DataType>
+void RedBlackTree<KeyType, DataType>::destroyDetachedNodes(
+	Node* node, 
+	RedBlackTreeNodePool<Node>& pool
+)
+{
+	cleanup(node);
+	pool.releaseAll();
+}
+
+template<typename KeyType, typename DataType>
+void RedBlackTree<KeyType, DataType>::reclaimInBackground(bool detached)
+{
+	// 节点与承载它们的内存块一起转交给后台线程。
+	struct DetachedNodes {
+		Node* root;
+		RedBlackTreeNodePool<Node> pool;
+	};
+
+	std::unique_ptr<DetachedNodes> detachedNodes(new DetachedNodes);
+	detachedNodes->root = this->root;
+	detachedNodes->pool.swap(this->nodePool);
+
+	// 线程在 waitForDeferredDestruction 中登记，无论之后是否被分离，都可以等待它结束。
+	std::thread thread;
+	RedBlackTreeReclaimWorkers::enter();
+	try {
+		thread = std::thread([nodes = detachedNodes.get()] {
+			std::unique_ptr<DetachedNodes> owner(nodes);
+			destroyDetachedNodes(owner->root, owner->pool);
+			owner.reset();
+			RedBlackTreeReclaimWorkers::leaveAtThreadExit();
+		});
+	}
+	catch (...) {
+		RedBlackTreeReclaimWorkers::cancel();
+		detachedNodes->pool.swap(this->nodePool); // 把内存块换回来，树保持不变。
+		throw;
+	}
+
+	// 线程已创建，所有权归后台线程。
+	detachedNodes.release();
+	this->root = nullptr;
+	this->resetState();
+
+	if (detached) {
+		thread.detach();
+	}
+	else {
+		this->reclaimThread = std::move(thread);
+	}
+}
+
+template<typename KeyType, typename DataType>
+void RedBlackTree<KeyType, DataType>::resetState()
+{
+	this->root = nullptr;
+	if (this->hashIndex != nullptr) {
+		this->hashIndex->clear();
+	}
+	if (this->hotKeyCache != nullptr) {
+		this->hotKeyCache->clear();
 	}
-	delete node;
+	this->leftmostNode = nullptr;
+	this->rightmostNode = nullptr;
+	this->compactionInProgress = false;
+	this->compactionCursor = nullptr;
 }
 
 template<typename KeyType, typename DataType>
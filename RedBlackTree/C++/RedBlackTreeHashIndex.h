@@ -0,0 +1,114 @@
+/**
+ * Red Black Tree Hash Index H
+ * by Flower Black
+ * 2022.1
+ * at Yushan County, Shangrao, Jiangxi
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * 红黑树的哈希旁路索引：键到节点指针的开放寻址哈希表。
+ * 
+ * 使用线性探测，删除时把后续元素向前移动（backward shift），不留墓碑。
+ * 槽位中保存哈希值，探测时先比较哈希值，只有哈希值相同才读取节点中的键。
+ * 装载因子不超过 1/2.
+ * 
+ * 索引只保存指针，不拥有节点。由树负责在节点增删、搬迁时同步索引。
+ */
+template <typename KeyType, typename NodeType>
+class RedBlackTreeHashIndex {
+
+public:
+	/** 索引的生命相关操作。 */
+	RedBlackTreeHashIndex();
+	~RedBlackTreeHashIndex();
+
+	/**
+	 * 清空索引。
+	 */
+	void clear();
+
+public:
+	/** 索引的基本操作。 */
+
+	/**
+	 * 查找键对应的节点。
+	 * 
+	 * @param key 键。
+	 * @return 键对应的节点。找不到时返回 nullptr.
+	 */
+	NodeType* find(const KeyType& key) const;
+
+	/**
+	 * 加入节点。节点的键不能已在索引中。
+	 * 
+	 * @param node 节点。
+	 */
+	void insert(NodeType* node);
+
+	/**
+	 * 移除节点。节点必须在索引中，且键与加入时相同。
+	 * 
+	 * @param node 节点。
+	 */
+	void erase(const NodeType* node);
+
+	/**
+	 * 节点被搬迁后，将索引中的旧指针替换为新指针。
+	 * 
+	 * @param oldNode 旧节点。必须在索引中。它的键可能已被移入新节点，不会被读取。
+	 * @param newNode 新节点。键与旧节点原来的键相同。
+	 */
+	void replace(const NodeType* oldNode, NodeType* newNode);
+
+	/**
+	 * 索引占用的内存（字节）。
+	 */
+	size_t getMemoryUsage() const;
+
+	/**
+	 * 计算键的哈希值。对 std::hash 的结果再做一次混合，
+	 * 因为整数的 std::hash 通常是恒等函数，直接取低位会让连续的键挤在一起。
+	 */
+	static uint64_t hashOf(const KeyType& key);
+
+private:
+	struct Slot {
+		uint64_t hash;
+
+		/** 为 nullptr 时槽位为空。 */
+		NodeType* node;
+	};
+
+	static constexpr size_t INITIAL_CAPACITY = 16;
+
+private:
+	/**
+	 * 查找保存该节点指针的槽位。
+	 * 
+	 * @param node 节点。
+	 * @param key 节点的键，用于确定探测的起点。节点的键被移走后，由调用者提供原来的键。
+	 */
+	size_t findSlot(const NodeType* node, const KeyType& key) const;
+
+	/**
+	 * 将容量扩大一倍，并重新放置所有元素。
+	 */
+	void grow();
+
+private:
+	std::vector<Slot> slots;
+
+	/**
+	 * 容量减一。容量总是 2 的幂。
+	 */
+	size_t mask = 0;
+
+	size_t count = 0;
+
+};
@@ -0,0 +1,165 @@
+/**
+ * Red Black Tree Hash Index Hpp
+ * by Flower Black
+ * 2022.1
+ * at Yushan County, Shangrao, Jiangxi
+ */
+
+#pragma once
+
+#include <functional>
+#include <utility>
+
+#include "RedBlackTreeHashIndex.h"
+
+template<typename KeyType, typename NodeType>
+RedBlackTreeHashIndex<KeyType, NodeType>::RedBlackTreeHashIndex()
+{
+}
+
+template<typename KeyType, typename NodeType>
+RedBlackTreeHashIndex<KeyType, NodeType>::~RedBlackTreeHashIndex()
+{
+}
+
+template<typename KeyType, typename NodeType>
+void RedBlackTreeHashIndex<KeyType, NodeType>::clear()
+{
+	std::vector<Slot>().swap(this->slots);
+	this->mask = 0;
+	this->count = 0;
+}
+
+template<typename KeyType, typename NodeType>
+NodeType* RedBlackTreeHashIndex<KeyType, NodeType>::find(const KeyType& key) const
+{
+	if (this->count == 0) {
+		return nullptr;
+	}
+
+	uint64_t hash = hashOf(key);
+	size_t index = size_t(hash) & this->mask;
+
+	while (this->slots[index].node != nullptr) {
+		const Slot& slot = this->slots[index];
+		if (slot.hash == hash && slot.node->key == key) {
+			return slot.node;
+		}
+
+		index = (index + 1) & this->mask;
+	}
+
+	return nullptr;
+}
+
+template<typename KeyType, typename NodeType>
+void RedBlackTreeHashIndex<KeyType, NodeType>::insert(NodeType* node)
+{
+	if ((this->count + 1) * 2 > this->slots.size()) {
+		this->grow();
+	}
+
+	uint64_t hash = hashOf(node->key);
+	size_t index = size_t(hash) & this->mask;
+	while (this->slots[index].node != nullptr) {
+		index = (index + 1) & this->mask;
+	}
+
+	this->slots[index].hash = hash;
+	this->slots[index].node = node;
+	this->count++;
+}
+
+template<typename KeyType, typename NodeType>
+void RedBlackTreeHashIndex<KeyType, NodeType>::erase(const NodeType* node)
+{
+	size_t hole = this->findSlot(node, node->key);
+
+	// 向前移动后续元素，直到遇到空槽，或遇到已在理想位置与空洞之间的元素。
+	size_t index = hole;
+	while (true) {
+		index = (index + 1) & this->mask;
+		if (this->slots[index].node == nullptr) {
+			break;
+		}
+
+		// 元素的理想位置循环地落在 (hole, index] 中时，它不能移到空洞处。
+		size_t home = size_t(this->slots[index].hash) & this->mask;
+		bool stays = hole <= index 
+			? (hole < home && home <= index) 
+			: (hole < home || home <= index);
+		if (stays) {
+			continue;
+		}
+
+		this->slots[hole] = this->slots[index];
+		hole = index;
+	}
+
+	this->slots[hole].node = nullptr;
+	this->count--;
+}
+
+template<typename KeyType, typename NodeType>
+void RedBlackTreeHashIndex<KeyType, NodeType>::replace(const NodeType* oldNode, NodeType* newNode)
+{
+	// 搬迁时旧节点的键已被移走（字符串变为空），只能用新节点的键确定探测起点。
+	this->slots[this->findSlot(oldNode, newNode->key)].node = newNode;
+}
+
+template<typename KeyType, typename NodeType>
+size_t RedBlackTreeHashIndex<KeyType, NodeType>::getMemoryUsage() const
+{
+	return this->slots.capacity() * sizeof(Slot);
+}
+
+template<typename KeyType, typename NodeType>
+uint64_t RedBlackTreeHashIndex<KeyType, NodeType>::hashOf(const KeyType& key)
+{
+	uint64_t hash = std::hash<KeyType>()(key);
+
+	// MurmurHash3 的 fmix64.
+	hash ^= hash >> 33;
+	hash *= 0xff51afd7ed558ccdULL;
+	hash ^= hash >> 33;
+	hash *= 0xc4ceb9fe1a85ec53ULL;
+	hash ^= hash >> 33;
+	return hash;
+}
+
+template<typename KeyType, typename NodeType>
+size_t RedBlackTreeHashIndex<KeyType, NodeType>::findSlot(
+	const NodeType* node,
+	const KeyType& key
+) const
+{
+	// 按指针比较，不需要比较键。
+	size_t index = size_t(hashOf(key)) & this->mask;
+	while (this->slots[index].node != node) {
+		index = (index + 1) & this->mask;
+	}
+
+	return index;
+}
+
+template<typename KeyType, typename NodeType>
+void RedBlackTreeHashIndex<KeyType, NodeType>::grow()
+{
+	size_t capacity = this->slots.empty() ? INITIAL_CAPACITY : this->slots.size() * 2;
+
+	std::vector<Slot> oldSlots(capacity, Slot { 0, nullptr });
+	oldSlots.swap(this->slots);
+	this->mask = capacity - 1;
+
+	for (const Slot& slot : oldSlots) {
+		if (slot.node == nullptr) {
+			continue;
+		}
+
+		size_t index = size_t(slot.hash) & this->mask;
+		while (this->slots[index].node != nullptr) {
+			index = (index + 1) & this->mask;
+		}
+		this->slots[index] = slot;
+	}
+}
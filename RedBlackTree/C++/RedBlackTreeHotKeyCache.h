@@ -0,0 +1,112 @@
+/**
+ * Red Black Tree Hot Key Cache H
+ * by Flower Black
+ * 2022.1
+ * at Yushan County, Shangrao, Jiangxi
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * 红黑树的热键缓存：容量固定的直接映射表，记录最近查到的键对应的节点。
+ * 
+ * 每个键只能放在由哈希值决定的一个槽位中，新记录直接覆盖旧记录，没有探测，也不会增长。
+ * 访问集中在少量热键上时，热键几乎总留在缓存里，查找不必从根下降。
+ * 槽位中保存哈希值，哈希值相同才读取节点中的键。
+ * 
+ * 缓存只保存指针，不拥有节点。由树负责在节点摘下、搬迁时使对应槽位失效。
+ */
+template <typename KeyType, typename NodeType>
+class RedBlackTreeHotKeyCache {
+
+public:
+	/** 缓存的生命相关操作。 */
+
+	/**
+	 * @param capacity 槽位数。向上取整为 2 的幂，至少为 1.
+	 */
+	explicit RedBlackTreeHotKeyCache(size_t capacity);
+	~RedBlackTreeHotKeyCache();
+
+	/**
+	 * 使所有槽位失效。命中统计保持不变。
+	 */
+	void clear();
+
+public:
+	/** 缓存的基本操作。 */
+
+	/**
+	 * 查找键对应的节点。不记入命中统计，由调用者决定是否调用 countLookup.
+	 * 
+	 * @param key 键。
+	 * @param hash 键的哈希值（RedBlackTreeHashIndex::hashOf）。
+	 * @return 键对应的节点。不在缓存中时返回 nullptr.
+	 */
+	NodeType* find(const KeyType& key, uint64_t hash);
+
+	/**
+	 * 记入一次查找的结果。
+	 * 
+	 * @param hit 是否命中。
+	 */
+	void countLookup(bool hit);
+
+	/**
+	 * 记录节点，覆盖同一槽位中原有的记录。
+	 * 
+	 * @param hash 节点的键的哈希值。
+	 * @param node 节点。
+	 */
+	void remember(uint64_t hash, NodeType* node);
+
+	/**
+	 * 节点即将被摘下时，使记录它的槽位失效。节点不在缓存中时不做任何事。
+	 * 
+	 * @param node 节点。键必须仍然有效。
+	 */
+	void erase(const NodeType* node);
+
+	/**
+	 * 节点被搬迁后，将缓存中的旧指针替换为新指针。旧节点不在缓存中时不做任何事。
+	 * 
+	 * @param oldNode 旧节点。
+	 * @param newNode 新节点。键与旧节点相同。
+	 */
+	void replace(const NodeType* oldNode, NodeType* newNode);
+
+public:
+	/** 统计信息。 */
+
+	size_t getHitCount() const;
+	size_t getMissCount() const;
+
+	/**
+	 * 缓存占用的内存（字节）。
+	 */
+	size_t getMemoryUsage() const;
+
+private:
+	struct Slot {
+		uint64_t hash;
+
+		/** 为 nullptr 时槽位为空。 */
+		NodeType* node;
+	};
+
+private:
+	std::vector<Slot> slots;
+
+	/**
+	 * 容量减一。
+	 */
+	size_t mask;
+
+	size_t hitCount = 0;
+	size_t missCount = 0;
+
+};
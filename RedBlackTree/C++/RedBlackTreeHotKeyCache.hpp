@@ -0,0 +1,105 @@
+/**
+ * Red Black Tree Hot Key Cache Hpp
+ * by Flower Black
+ * 2022.1
+ * at Yushan County, Shangrao, Jiangxi
+ */
+
+#pragma once
+
+#include "RedBlackTreeHashIndex.hpp"
+#include "RedBlackTreeHotKeyCache.h"
+
+template<typename KeyType, typename NodeType>
+RedBlackTreeHotKeyCache<KeyType, NodeType>::RedBlackTreeHotKeyCache(size_t capacity)
+{
+	size_t roundedCapacity = 1;
+	while (roundedCapacity < capacity) {
+		roundedCapacity *= 2;
+	}
+
+	this->slots.assign(roundedCapacity, Slot{ 0, nullptr });
+	this->mask = roundedCapacity - 1;
+}
+
+template<typename KeyType, typename NodeType>
+RedBlackTreeHotKeyCache<KeyType, NodeType>::~RedBlackTreeHotKeyCache()
+{
+}
+
+template<typename KeyType, typename NodeType>
+void RedBlackTreeHotKeyCache<KeyType, NodeType>::clear()
+{
+	for (Slot& slot : this->slots) {
+		slot.node = nullptr;
+	}
+}
+
+template<typename KeyType, typename NodeType>
+NodeType* RedBlackTreeHotKeyCache<KeyType, NodeType>::find(const KeyType& key, uint64_t hash)
+{
+	const Slot& slot = this->slots[size_t(hash) & this->mask];
+	if (slot.node != nullptr && slot.hash == hash && slot.node->key == key) {
+		return slot.node;
+	}
+
+	return nullptr;
+}
+
+template<typename KeyType, typename NodeType>
+void RedBlackTreeHotKeyCache<KeyType, NodeType>::countLookup(bool hit)
+{
+	if (hit) {
+		this->hitCount++;
+	}
+	else {
+		this->missCount++;
+	}
+}
+
+template<typename KeyType, typename NodeType>
+void RedBlackTreeHotKeyCache<KeyType, NodeType>::remember(uint64_t hash, NodeType* node)
+{
+	Slot& slot = this->slots[size_t(hash) & this->mask];
+	slot.hash = hash;
+	slot.node = node;
+}
+
+template<typename KeyType, typename NodeType>
+void RedBlackTreeHotKeyCache<KeyType, NodeType>::erase(const NodeType* node)
+{
+	uint64_t hash = RedBlackTreeHashIndex<KeyType, NodeType>::hashOf(node->key);
+	Slot& slot = this->slots[size_t(hash) & this->mask];
+	if (slot.node == node) {
+		slot.node = nullptr;
+	}
+}
+
+template<typename KeyType, typename NodeType>
+void RedBlackTreeHotKeyCache<KeyType, NodeType>::replace(const NodeType* oldNode, NodeType* newNode)
+{
+	// 旧节点的键可能已被移走，用新节点的键计算槽位。
+	uint64_t hash = RedBlackTreeHashIndex<KeyType, NodeType>::hashOf(newNode->key);
+	Slot& slot = this->slots[size_t(hash) & this->mask];
+	if (slot.node == oldNode) {
+		slot.node = newNode;
+	}
+}
+
+template<typename KeyType, typename NodeType>
+size_t RedBlackTreeHotKeyCache<KeyType, NodeType>::getHitCount() const
+{
+	return this->hitCount;
+}
+
+template<typename KeyType, typename NodeType>
+size_t RedBlackTreeHotKeyCache<KeyType, NodeType>::getMissCount() const
+{
+	return this->missCount;
+}
+
+template<typename KeyType, typename NodeType>
+size_t RedBlackTreeHotKeyCache<KeyType, NodeType>::getMemoryUsage() const
+{
+	return this->slots.capacity() * sizeof(Slot);
+}
@@ -0,0 +1,62 @@
+/**
+ * Red Black Tree Key Prefix H
+ * by Flower Black
+ * 2022.1
+ * at Yushan County, Shangrao, Jiangxi
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+/**
+ * 节点中缓存的键前缀，以及利用它进行的键比较。
+ * 
+ * 默认实现不缓存任何内容（空基类，不占用节点空间），直接比较键本身。
+ */
+template <typename KeyType>
+struct RedBlackTreeKeyPrefix {
+	/**
+	 * 根据键设置前缀。键被修改后需要重新调用。
+	 * 
+	 * @param key 键。
+	 */
+	void setKeyPrefix(const KeyType& key);
+
+	/**
+	 * 比较两个键。
+	 * 
+	 * @param a 第一个键。
+	 * @param aPrefix 第一个键的前缀。
+	 * @param b 第二个键。
+	 * @param bPrefix 第二个键的前缀。
+	 * @return a 小于、等于、大于 b 时，分别返回负数、0、正数。
+	 */
+	static int compareKeys(
+		const KeyType& a, const RedBlackTreeKeyPrefix& aPrefix,
+		const KeyType& b, const RedBlackTreeKeyPrefix& bPrefix
+	);
+};
+
+/**
+ * std::string 键在节点内缓存前 8 个字节。
+ * 
+ * 前缀按大端序装进一个无符号整数，不足 8 字节时以 0 补齐，
+ * 因此前缀不同时，整数的大小关系就是字符串的大小关系，不需要访问字符串在堆上的内容。
+ * 前缀相同、且至少有一个键不超过 8 字节时，较短的键是较长键的前缀，比较长度即可。
+ * 只有两个键都超过 8 字节且前缀相同时，才从第 9 个字节开始比较内容。
+ */
+template <>
+struct RedBlackTreeKeyPrefix<std::string> {
+	static constexpr size_t PREFIX_LENGTH = sizeof(uint64_t);
+
+	uint64_t keyPrefix = 0;
+
+	void setKeyPrefix(const std::string& key);
+
+	static int compareKeys(
+		const std::string& a, const RedBlackTreeKeyPrefix& aPrefix,
+		const std::string& b, const RedBlackTreeKeyPrefix& bPrefix
+	);
+};
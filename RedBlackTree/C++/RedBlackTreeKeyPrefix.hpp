@@ -0,0 +1,70 @@
+/**
+ * Red Black Tree Key Prefix Hpp
+ * by Flower Black
+ * 2022.1
+ * at Yushan County, Shangrao, Jiangxi
+ */
+
+#pragma once
+
+#include <cstring>
+
+#include "RedBlackTreeKeyPrefix.h"
+
+template<typename KeyType>
+inline void RedBlackTreeKeyPrefix<KeyType>::setKeyPrefix(const KeyType&)
+{
+}
+
+template<typename KeyType>
+inline int RedBlackTreeKeyPrefix<KeyType>::compareKeys(
+	const KeyType& a, const RedBlackTreeKeyPrefix&,
+	const KeyType& b, const RedBlackTreeKeyPrefix&
+)
+{
+	if (a == b) {
+		return 0;
+	}
+
+	return a < b ? -1 : 1;
+}
+
+inline void RedBlackTreeKeyPrefix<std::string>::setKeyPrefix(const std::string& key)
+{
+	size_t length = key.size() < PREFIX_LENGTH ? key.size() : PREFIX_LENGTH;
+
+	uint64_t prefix = 0;
+	for (size_t i = 0; i < length; i++) {
+		prefix |= uint64_t(static_cast<unsigned char>(key[i])) << (8 * (PREFIX_LENGTH - 1 - i));
+	}
+
+	this->keyPrefix = prefix;
+}
+
+inline int RedBlackTreeKeyPrefix<std::string>::compareKeys(
+	const std::string& a, const RedBlackTreeKeyPrefix& aPrefix,
+	const std::string& b, const RedBlackTreeKeyPrefix& bPrefix
+)
+{
+	if (aPrefix.keyPrefix != bPrefix.keyPrefix) {
+		return aPrefix.keyPrefix < bPrefix.keyPrefix ? -1 : 1;
+	}
+
+	// 前缀相同。字符串的长度保存在节点内的字符串对象里，读取它不会访问堆。
+	size_t aLength = a.size();
+	size_t bLength = b.size();
+
+	if (aLength > PREFIX_LENGTH && bLength > PREFIX_LENGTH) {
+		size_t length = (aLength < bLength ? aLength : bLength) - PREFIX_LENGTH;
+		int result = std::memcmp(a.data() + PREFIX_LENGTH, b.data() + PREFIX_LENGTH, length);
+		if (result != 0) {
+			return result;
+		}
+	}
+
+	if (aLength == bLength) {
+		return 0;
+	}
+
+	return aLength < bLength ? -1 : 1;
+}
@@ -0,0 +1,150 @@
+/**
+ * Red Black Tree Merge Iterator H
+ * by Flower Black
+ * 2022.1
+ * at Yushan County, Shangrao, Jiangxi
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <vector>
+
+#include "RedBlackTree.hpp"
+
+/**
+ * 合并时，某个键在一棵树中的出现。
+ */
+template <typename DataType>
+struct RedBlackTreeMergeCandidate {
+	/** 所在的树在输入列表中的下标。 */
+	size_t treeIndex;
+
+	/** 该树中的数据。 */
+	DataType* data;
+};
+
+/**
+ * 默认的冲突解决方式：下标最大的树（最新的分区）胜出。
+ * 
+ * 自定义的冲突解决方式形如：
+ *   DataType* (const KeyType& key, const std::vector<RedBlackTreeMergeCandidate<DataType>>& candidates)
+ * candidates 按树的下标从小到大排列，至少有一个元素。
+ * 返回要输出的数据；返回 nullptr 时跳过该键（例如最新的值是删除标记）。
+ */
+struct RedBlackTreeMergeNewestWins {
+	template <typename KeyType, typename DataType>
+	DataType* operator () (
+		const KeyType&, 
+		const std::vector<RedBlackTreeMergeCandidate<DataType>>& candidates
+	) const;
+};
+
+/**
+ * 多棵红黑树的有序归并迭代器。
+ * 
+ * 每棵树一个中序游标，游标放在以（键，树下标）为序的小根堆中。
+ * 每一步取出键最小的所有游标，交给冲突解决方式选出一个数据，再把这些游标各自后移。
+ * 不复制键和数据，也不预先生成结果：每一步的代价为 O(k log n)，k 为该键出现的树数，n 为树数。
+ * 
+ * 迭代期间不可修改任何一棵树。
+ * 
+ * 用法：
+ *   for (RedBlackTreeMergeIterator<K, D> it(trees); it.isValid(); it.next()) {
+ *       use(it.key(), it.data());
+ *   }
+ */
+template <
+	typename KeyType, 
+	typename DataType, 
+	typename ResolverType = RedBlackTreeMergeNewestWins
+>
+class RedBlackTreeMergeIterator {
+
+public:
+	/** 迭代器的生命相关操作。 */
+
+	/**
+	 * 创建迭代器，并定位到范围内的第一个键。
+	 * 
+	 * @param trees 参与归并的树。下标越大的树越新。
+	 * @param lowerBound 范围下界（包含）。不指定时从最小的键开始。
+	 * @param upperBound 范围上界（不包含）。不指定时到最大的键为止。
+	 * @param resolver 冲突解决方式。
+	 */
+	explicit RedBlackTreeMergeIterator(
+		const std::vector<RedBlackTree<KeyType, DataType>*>& trees,
+		const std::optional<KeyType>& lowerBound = std::nullopt,
+		const std::optional<KeyType>& upperBound = std::nullopt,
+		ResolverType resolver = ResolverType()
+	);
+
+public:
+	/** 迭代操作。 */
+
+	/**
+	 * 迭代器是否指向一个元素。
+	 */
+	bool isValid() const;
+
+	/**
+	 * 当前元素的键。
+	 */
+	const KeyType& key() const;
+
+	/**
+	 * 当前元素的数据（由冲突解决方式选出）。
+	 */
+	DataType& data() const;
+
+	/**
+	 * 移到下一个键。
+	 */
+	void next();
+
+private:
+	using Handle = typename RedBlackTree<KeyType, DataType>::Handle;
+
+private:
+	/**
+	 * 堆中 a 是否应排在 b 之后（键更大，或键相同而树下标更大）。
+	 */
+	bool isAfter(size_t a, size_t b) const;
+
+	void pushCursor(size_t treeIndex);
+	size_t popCursor();
+
+	/**
+	 * 判断句柄是否仍在范围内。
+	 */
+	bool isInRange(const Handle& handle) const;
+
+	/**
+	 * 找到下一个未被冲突解决方式跳过的键。
+	 */
+	void advance();
+
+private:
+	/**
+	 * 每棵树的游标。
+	 */
+	std::vector<Handle> cursors;
+
+	/**
+	 * 游标的小根堆，存放树的下标。
+	 */
+	std::vector<size_t> heap;
+
+	std::optional<KeyType> upperBound;
+	ResolverType resolver;
+
+	/**
+	 * 当前键的所有出现。复用以避免每步分配。
+	 */
+	std::vector<RedBlackTreeMergeCandidate<DataType>> candidates;
+
+	const KeyType* currentKey = nullptr;
+	DataType* currentData = nullptr;
+
+};
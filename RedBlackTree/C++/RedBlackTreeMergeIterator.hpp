@@ -0,0 +1,195 @@
+/**
+ * Red Black Tree Merge Iterator Hpp
+ * by Flower Black
+ * 2022.1
+ * at Yushan County, Shangrao, Jiangxi
+ */
+
+#pragma once
+
+#include <utility>
+
+#include "RedBlackTreeMergeIterator.h"
+
+template<typename KeyType, typename DataType>
+DataType* RedBlackTreeMergeNewestWins::operator () (
+	const KeyType&, 
+	const std::vector<RedBlackTreeMergeCandidate<DataType>>& candidates
+) const
+{
+	return candidates.back().data;
+}
+
+template<typename KeyType, typename DataType, typename ResolverType>
+RedBlackTreeMergeIterator<KeyType, DataType, ResolverType>::RedBlackTreeMergeIterator(
+	const std::vector<RedBlackTree<KeyType, DataType>*>& trees,
+	const std::optional<KeyType>& lowerBound,
+	const std::optional<KeyType>& upperBound,
+	ResolverType resolver
+) : upperBound(upperBound), resolver(std::move(resolver))
+{
+	this->cursors.resize(trees.size());
+	this->heap.reserve(trees.size());
+	this->candidates.reserve(trees.size());
+
+	for (size_t i = 0; i < trees.size(); i++) {
+		RedBlackTree<KeyType, DataType>& tree = *trees[i];
+
+		if (lowerBound.has_value()) {
+			this->cursors[i] = tree.lowerBound(*lowerBound);
+		}
+		else if (!tree.isEmpty()) {
+			this->cursors[i] = tree.min();
+		}
+
+		if (this->isInRange(this->cursors[i])) {
+			this->pushCursor(i);
+		}
+	}
+
+	this->advance();
+}
+
+template<typename KeyType, typename DataType, typename ResolverType>
+bool RedBlackTreeMergeIterator<KeyType, DataType, ResolverType>::isValid() const
+{
+	return this->currentKey != nullptr;
+}
+
+template<typename KeyType, typename DataType, typename ResolverType>
+const KeyType& RedBlackTreeMergeIterator<KeyType, DataType, ResolverType>::key() const
+{
+	return *this->currentKey;
+}
+
+template<typename KeyType, typename DataType, typename ResolverType>
+DataType& RedBlackTreeMergeIterator<KeyType, DataType, ResolverType>::data() const
+{
+	return *this->currentData;
+}
+
+template<typename KeyType, typename DataType, typename ResolverType>
+void RedBlackTreeMergeIterator<KeyType, DataType, ResolverType>::next()
+{
+	this->advance();
+}
+
+template<typename KeyType, typename DataType, typename ResolverType>
+void RedBlackTreeMergeIterator<KeyType, DataType, ResolverType>::advance()
+{
+	while (!this->heap.empty()) {
+		// 取出键最小的所有游标。相同的键按树下标从小到大出堆。
+		this->candidates.clear();
+
+		size_t treeIndex = this->popCursor();
+		Handle first = this->cursors[treeIndex];
+		this->candidates.push_back({ treeIndex, &first.data() });
+
+		while (!this->heap.empty() && this->cursors[this->heap.front()].key() == first.key()) {
+			size_t sameKeyIndex = this->popCursor();
+			this->candidates.push_back({ sameKeyIndex, &this->cursors[sameKeyIndex].data() });
+		}
+
+		// 被取出的游标各自后移，仍在范围内的放回堆中。
+		// 节点不会因为游标移动而失效，因此 first 的键仍可引用。
+		for (const RedBlackTreeMergeCandidate<DataType>& candidate : this->candidates) {
+			Handle& cursor = this->cursors[candidate.treeIndex];
+			cursor = cursor.next();
+			if (this->isInRange(cursor)) {
+				this->pushCursor(candidate.treeIndex);
+			}
+		}
+
+		DataType* chosen = this->resolver(first.key(), this->candidates);
+		if (chosen != nullptr) {
+			this->currentKey = &first.key();
+			this->currentData = chosen;
+			return;
+		}
+	}
+
+	this->currentKey = nullptr;
+	this->currentData = nullptr;
+}
+
+template<typename KeyType, typename DataType, typename ResolverType>
+bool RedBlackTreeMergeIterator<KeyType, DataType, ResolverType>::isAfter(size_t a, size_t b) const
+{
+	const KeyType& aKey = this->cursors[a].key();
+	const KeyType& bKey = this->cursors[b].key();
+
+	if (bKey < aKey) {
+		return true;
+	}
+	if (aKey < bKey) {
+		return false;
+	}
+
+	return a > b;
+}
+
+template<typename KeyType, typename DataType, typename ResolverType>
+void RedBlackTreeMergeIterator<KeyType, DataType, ResolverType>::pushCursor(size_t treeIndex)
+{
+	// 上浮。
+	size_t position = this->heap.size();
+	this->heap.push_back(treeIndex);
+
+	while (position > 0) {
+		size_t parent = (position - 1) / 2;
+		if (!this->isAfter(this->heap[parent], treeIndex)) {
+			break;
+		}
+
+		this->heap[position] = this->heap[parent];
+		position = parent;
+	}
+
+	this->heap[position] = treeIndex;
+}
+
+template<typename KeyType, typename DataType, typename ResolverType>
+size_t RedBlackTreeMergeIterator<KeyType, DataType, ResolverType>::popCursor()
+{
+	size_t top = this->heap.front();
+	size_t last = this->heap.back();
+	this->heap.pop_back();
+
+	if (this->heap.empty()) {
+		return top;
+	}
+
+	// 把最后一个元素放到堆顶，下沉。
+	size_t position = 0;
+	size_t size = this->heap.size();
+	while (true) {
+		size_t child = position * 2 + 1;
+		if (child >= size) {
+			break;
+		}
+		if (child + 1 < size && this->isAfter(this->heap[child], this->heap[child + 1])) {
+			child++;
+		}
+		if (!this->isAfter(last, this->heap[child])) {
+			break;
+		}
+
+		this->heap[position] = this->heap[child];
+		position = child;
+	}
+
+	this->heap[position] = last;
+	return top;
+}
+
+template<typename KeyType, typename DataType, typename ResolverType>
+bool RedBlackTreeMergeIterator<KeyType, DataType, ResolverType>::isInRange(
+	const Handle& handle
+) const
+{
+	if (!handle.isValid()) {
+		return false;
+	}
+
+	return !this->upperBound.has_value() || handle.key() < *this->upperBound;
+}
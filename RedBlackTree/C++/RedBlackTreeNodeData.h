@@ -0,0 +1,33 @@
+/**
+ * Red Black Tree Node Data H
+ * by Flower Black
+ * 2022.1
+ * at Yushan County, Shangrao, Jiangxi
+ */
+
+#pragma once
+
+/**
+ * 节点中的数据域。
+ */
+template <typename DataType>
+struct RedBlackTreeNodeData {
+	DataType data;
+};
+
+/**
+ * 红黑集合（RedBlackSet）使用的占位数据类型。
+ */
+struct RedBlackSetNoData {
+};
+
+/**
+ * 红黑集合的节点不携带数据。数据域是空基类，不占用节点空间。
+ * 为了让遍历等通用代码照常编译，提供一个所有节点共享的静态占位数据。
+ * 占位数据是常量，不能通过任何接口修改，因此多个线程同时读取也不会冲突；
+ * 返回 DataType& 的接口（getData 等）对集合无法编译。
+ */
+template <>
+struct RedBlackTreeNodeData<RedBlackSetNoData> {
+	static constexpr RedBlackSetNoData data {};
+};
@@ -0,0 +1,214 @@
+/**
+ * Red Black Tree Node Pool H
+ * by Flower Black
+ * 2022.1
+ * at Yushan County, Shangrao, Jiangxi
+ */
+
+#pragma once
+
+#include <cstddef>
+
+/**
+ * 红黑树节点的内存池。
+ * 
+ * 节点存放在按 BLOCK_SIZE 对齐的内存块中，因此由节点地址即可算出所在的块。
+ * 块的大小默认为 16 KiB；节点较大时取能容纳至少 MIN_SLOTS_PER_BLOCK 个节点的最小的 2 的幂。
+ * 普通分配优先复用已释放的槽位；连续分配只从当前块的末尾依次取槽位，
+ * 供整理内存布局时把相邻的节点放到相邻的地址上。
+ * 
+ * 除了正在连续分配的块，节点全部释放的块会立即归还给系统。
+ * 
+ * 块可以被“退役”：退役的块不再分配新槽位，其中的节点全部释放后，块会立即归还给系统。
+ * 
+ * 内存池只管理内存，不负责构造和析构节点。
+ */
+template <typename NodeType>
+class RedBlackTreeNodePool {
+
+public:
+	/** 内存池的生命相关操作。 */
+	RedBlackTreeNodePool();
+
+	/**
+	 * 归还所有内存块。调用前应析构所有节点。
+	 */
+	~RedBlackTreeNodePool();
+
+	RedBlackTreeNodePool(const RedBlackTreeNodePool&) = delete;
+	RedBlackTreeNodePool& operator = (const RedBlackTreeNodePool&) = delete;
+
+public:
+	/** 分配与释放。 */
+
+	/**
+	 * 分配一个节点大小的槽位。优先复用已释放的槽位。
+	 * 
+	 * @return 未构造的槽位。
+	 * @exception bad_alloc 内存不足时抛出。
+	 */
+	void* allocate();
+
+	/**
+	 * 从当前块的末尾分配一个槽位，不复用已释放的槽位。
+	 * 连续调用得到的槽位在地址上相邻（跨块时除外）。
+	 * 
+	 * @return 未构造的槽位。
+	 * @exception bad_alloc 内存不足时抛出。
+	 */
+	void* allocateContiguous();
+
+	/**
+	 * 释放槽位。槽位中的节点应当已经析构。
+	 * 
+	 * @param slot 由本内存池分配的槽位。
+	 */
+	void deallocate(void* slot);
+
+	/**
+	 * 归还所有内存块。调用前应析构所有节点。
+	 */
+	void releaseAll();
+
+	/**
+	 * 与另一个内存池交换所有内存块。用于把整棵树的内存整体转交出去。
+	 * 
+	 * @param other 另一个内存池。
+	 */
+	void swap(RedBlackTreeNodePool& other);
+
+public:
+	/** 块的退役。 */
+
+	/**
+	 * 让现有的所有块退役。此后的分配只使用新块。
+	 * 没有节点的块会立即被归还。
+	 */
+	void retireAll();
+
+	/**
+	 * 判断槽位是否位于退役的块中。
+	 * 
+	 * @param slot 由本内存池分配的槽位。
+	 */
+	bool isRetired(const void* slot) const;
+
+	/**
+	 * 当前持有的内存块数目（包括退役的块）。
+	 */
+	size_t getBlockCount() const;
+
+private:
+	/**
+	 * 已释放的槽位。链接成块内的空闲链表。
+	 */
+	struct FreeSlot {
+		FreeSlot* next;
+	};
+
+	/**
+	 * 内存块的头部。位于块的起始地址，槽位紧随其后。
+	 */
+	struct Block {
+		/** 所有块组成的双向链表。 */
+		Block* previous;
+		Block* next;
+
+		/** 有空闲槽位的块组成的双向链表。 */
+		Block* previousPartial;
+		Block* nextPartial;
+		bool inPartialList;
+
+		FreeSlot* freeList;
+
+		/** 块中存活的节点数。 */
+		size_t liveCount;
+
+		/** 已从块末尾分出去的槽位数。 */
+		size_t usedCount;
+
+		bool retired;
+	};
+
+	static constexpr size_t SLOT_ALIGNMENT = 
+		alignof(NodeType) > alignof(FreeSlot) ? alignof(NodeType) : alignof(FreeSlot);
+
+	static constexpr size_t SLOT_SIZE = 
+		((sizeof(NodeType) > sizeof(FreeSlot) ? sizeof(NodeType) : sizeof(FreeSlot)) 
+			+ SLOT_ALIGNMENT - 1) / SLOT_ALIGNMENT * SLOT_ALIGNMENT;
+
+	static constexpr size_t SLOTS_OFFSET = 
+		(sizeof(Block) + SLOT_ALIGNMENT - 1) / SLOT_ALIGNMENT * SLOT_ALIGNMENT;
+
+	/**
+	 * 块的默认大小，以及每块至少容纳的节点数。
+	 */
+	static constexpr size_t DEFAULT_BLOCK_SIZE = 16384;
+	static constexpr size_t MIN_SLOTS_PER_BLOCK = 4;
+
+	/**
+	 * 不小于 DEFAULT_BLOCK_SIZE、且能容纳 MIN_SLOTS_PER_BLOCK 个槽位的最小的 2 的幂。
+	 */
+	static constexpr size_t blockSizeFor(size_t requiredSize)
+	{
+		size_t size = DEFAULT_BLOCK_SIZE;
+		while (size < requiredSize) {
+			size *= 2;
+		}
+		return size;
+	}
+
+public:
+	/**
+	 * 内存块的大小（字节）。块的起始地址按该值对齐。
+	 */
+	static constexpr size_t BLOCK_SIZE = blockSizeFor(SLOTS_OFFSET + MIN_SLOTS_PER_BLOCK * SLOT_SIZE);
+
+private:
+	static constexpr size_t SLOTS_PER_BLOCK = (BLOCK_SIZE - SLOTS_OFFSET) / SLOT_SIZE;
+
+private:
+	/**
+	 * 由槽位地址求所在的块。
+	 */
+	static Block* blockOf(const void* slot);
+
+	/**
+	 * 申请一个新块，并挂到块链表上。
+	 */
+	Block* createBlock();
+
+	/**
+	 * 把块挂到有空闲槽位的块链表上。
+	 */
+	void linkPartial(Block* block);
+
+	/**
+	 * 把块从有空闲槽位的块链表上摘下。
+	 */
+	void unlinkPartial(Block* block);
+
+	/**
+	 * 从块链表（以及有空闲槽位的块链表）上摘下块，并归还给系统。
+	 */
+	void releaseBlock(Block* block);
+
+private:
+	/**
+	 * 所有块组成的链表的表头。
+	 */
+	Block* blocks = nullptr;
+
+	/**
+	 * 连续分配使用的块。
+	 */
+	Block* currentBlock = nullptr;
+
+	/**
+	 * 空闲链表非空、未退役的块组成的链表的表头。
+	 */
+	Block* partialBlocks = nullptr;
+
+	size_t blockCount = 0;
+
+};
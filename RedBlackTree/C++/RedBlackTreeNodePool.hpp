@@ -0,0 +1,234 @@
+/**
+ * Red Black Tree Node Pool Hpp
+ * by Flower Black
+ * 2022.1
+ * at Yushan County, Shangrao, Jiangxi
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <new>
+#include <utility>
+
+#include "RedBlackTreeNodePool.h"
+
+template<typename NodeType>
+RedBlackTreeNodePool<NodeType>::RedBlackTreeNodePool()
+{
+}
+
+template<typename NodeType>
+RedBlackTreeNodePool<NodeType>::~RedBlackTreeNodePool()
+{
+	this->releaseAll();
+}
+
+template<typename NodeType>
+void* RedBlackTreeNodePool<NodeType>::allocate()
+{
+	// 先找有空闲槽位的块。空闲槽位用完的块从链表上摘下。
+	if (this->partialBlocks != nullptr) {
+		Block* block = this->partialBlocks;
+		FreeSlot* slot = block->freeList;
+		block->freeList = slot->next;
+		block->liveCount++;
+		if (block->freeList == nullptr) {
+			this->unlinkPartial(block);
+		}
+		return slot;
+	}
+
+	return this->allocateContiguous();
+}
+
+template<typename NodeType>
+void* RedBlackTreeNodePool<NodeType>::allocateContiguous()
+{
+	if (this->currentBlock == nullptr || this->currentBlock->usedCount == SLOTS_PER_BLOCK) {
+		// 换下的块若已经空了，不会再有释放操作触发归还，在这里归还。
+		if (this->currentBlock != nullptr && this->currentBlock->liveCount == 0) {
+			this->releaseBlock(this->currentBlock);
+		}
+		this->currentBlock = this->createBlock();
+	}
+
+	Block* block = this->currentBlock;
+	void* slot = reinterpret_cast<char*>(block) + SLOTS_OFFSET + block->usedCount * SLOT_SIZE;
+	block->usedCount++;
+	block->liveCount++;
+	return slot;
+}
+
+template<typename NodeType>
+void RedBlackTreeNodePool<NodeType>::deallocate(void* slot)
+{
+	Block* block = blockOf(slot);
+	block->liveCount--;
+
+	if (block->retired) {
+		// 退役的块不再复用槽位。最后一个节点离开时归还整个块。
+		if (block->liveCount == 0) {
+			this->releaseBlock(block);
+		}
+		return;
+	}
+
+	if (block->liveCount == 0 && block != this->currentBlock) {
+		// 块已经空了，归还给系统。正在连续分配的块保留，避免在块的边界上反复申请和归还。
+		this->releaseBlock(block);
+		return;
+	}
+
+	FreeSlot* freeSlot = static_cast<FreeSlot*>(slot);
+	freeSlot->next = block->freeList;
+	block->freeList = freeSlot;
+
+	if (!block->inPartialList) {
+		this->linkPartial(block);
+	}
+}
+
+template<typename NodeType>
+void RedBlackTreeNodePool<NodeType>::releaseAll()
+{
+	while (this->blocks != nullptr) {
+		this->releaseBlock(this->blocks);
+	}
+
+	this->currentBlock = nullptr;
+	this->partialBlocks = nullptr;
+}
+
+template<typename NodeType>
+void RedBlackTreeNodePool<NodeType>::swap(RedBlackTreeNodePool& other)
+{
+	std::swap(this->blocks, other.blocks);
+	std::swap(this->currentBlock, other.currentBlock);
+	std::swap(this->partialBlocks, other.partialBlocks);
+	std::swap(this->blockCount, other.blockCount);
+}
+
+template<typename NodeType>
+void RedBlackTreeNodePool<NodeType>::retireAll()
+{
+	Block* block = this->blocks;
+	while (block != nullptr) {
+		Block* nextBlock = block->next;
+
+		block->retired = true;
+		block->freeList = nullptr;
+		block->previousPartial = nullptr;
+		block->nextPartial = nullptr;
+		block->inPartialList = false;
+		if (block->liveCount == 0) {
+			this->releaseBlock(block);
+		}
+
+		block = nextBlock;
+	}
+
+	this->currentBlock = nullptr;
+	this->partialBlocks = nullptr;
+}
+
+template<typename NodeType>
+bool RedBlackTreeNodePool<NodeType>::isRetired(const void* slot) const
+{
+	return blockOf(slot)->retired;
+}
+
+template<typename NodeType>
+size_t RedBlackTreeNodePool<NodeType>::getBlockCount() const
+{
+	return this->blockCount;
+}
+
+template<typename NodeType>
+typename RedBlackTreeNodePool<NodeType>::Block* RedBlackTreeNodePool<NodeType>::blockOf(
+	const void* slot
+)
+{
+	uintptr_t address = reinterpret_cast<uintptr_t>(slot);
+	return reinterpret_cast<Block*>(address & ~static_cast<uintptr_t>(BLOCK_SIZE - 1));
+}
+
+template<typename NodeType>
+typename RedBlackTreeNodePool<NodeType>::Block* RedBlackTreeNodePool<NodeType>::createBlock()
+{
+	void* memory = ::operator new(BLOCK_SIZE, std::align_val_t(BLOCK_SIZE));
+
+	Block* block = new (memory) Block;
+	block->previous = nullptr;
+	block->next = this->blocks;
+	block->previousPartial = nullptr;
+	block->nextPartial = nullptr;
+	block->inPartialList = false;
+	block->freeList = nullptr;
+	block->liveCount = 0;
+	block->usedCount = 0;
+	block->retired = false;
+
+	if (this->blocks != nullptr) {
+		this->blocks->previous = block;
+	}
+	this->blocks = block;
+	this->blockCount++;
+
+	return block;
+}
+
+template<typename NodeType>
+void RedBlackTreeNodePool<NodeType>::linkPartial(Block* block)
+{
+	block->inPartialList = true;
+	block->previousPartial = nullptr;
+	block->nextPartial = this->partialBlocks;
+	if (this->partialBlocks != nullptr) {
+		this->partialBlocks->previousPartial = block;
+	}
+	this->partialBlocks = block;
+}
+
+template<typename NodeType>
+void RedBlackTreeNodePool<NodeType>::unlinkPartial(Block* block)
+{
+	if (block->previousPartial != nullptr) {
+		block->previousPartial->nextPartial = block->nextPartial;
+	}
+	else {
+		this->partialBlocks = block->nextPartial;
+	}
+	if (block->nextPartial != nullptr) {
+		block->nextPartial->previousPartial = block->previousPartial;
+	}
+
+	block->previousPartial = nullptr;
+	block->nextPartial = nullptr;
+	block->inPartialList = false;
+}
+
+template<typename NodeType>
+void RedBlackTreeNodePool<NodeType>::releaseBlock(Block* block)
+{
+	if (block->inPartialList) {
+		this->unlinkPartial(block);
+	}
+	if (block == this->currentBlock) {
+		this->currentBlock = nullptr;
+	}
+
+	if (block->previous != nullptr) {
+		block->previous->next = block->next;
+	}
+	else {
+		this->blocks = block->next;
+	}
+	if (block->next != nullptr) {
+		block->next->previous = block->previous;
+	}
+
+	this->blockCount--;
+	block->~Block();
+	::operator delete(static_cast<void*>(block), std::align_val_t(BLOCK_SIZE));
+}
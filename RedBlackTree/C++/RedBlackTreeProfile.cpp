@@ -0,0 +1,534 @@
+/**
+ * Red Black Tree Profile
+ * by Flower Black
+ * 2022.1
+ * at Yushan County, Shangrao, Jiangxi
+ */
+
+/*
+	红黑树操作的性能剖析程序。对每种负载测量每次操作的时间与硬件计数器。
+
+	编译：g++ -std=c++17 -O2 -pthread RedBlackTreeProfile.cpp -o RedBlackTreeProfile
+	运行：./RedBlackTreeProfile [节点数，默认 1000000]
+
+	硬件计数器不可用时（例如 /proc/sys/kernel/perf_event_paranoid 过高，或在容器、虚拟机中），
+	对应的列显示 n/a，时间依然有效。
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "BufferedRedBlackTree.hpp"
+#include "ConcurrentRedBlackTree.hpp"
+#include "DurableRedBlackTree.hpp"
+#include "PagedRedBlackTree.hpp"
+#include "PerfEventProfiler.hpp"
+#include "RedBlackTree.hpp"
+#include "RedBlackTreeMergeIterator.hpp"
+#include "TopDownRedBlackTree.hpp"
+
+namespace {
+
+	/**
+	 * 防止被测代码的结果被编译器优化掉。
+	 */
+	volatile long sink;
+
+	/**
+	 * 生成 count 个互不相同的随机键。
+	 */
+	std::vector<long> makeKeys(size_t count, std::mt19937_64& random)
+	{
+		std::vector<long> keys(count);
+		for (size_t i = 0; i < count; i++) {
+			keys[i] = long(i) * 2; // 偶数都在树里，奇数都不在。
+		}
+		std::shuffle(keys.begin(), keys.end(), random);
+		return keys;
+	}
+
+	/**
+	 * 生成 count 个随机的 32 字符十六进制字符串键。
+	 */
+	std::vector<std::string> makeStringKeys(size_t count, std::mt19937_64& random)
+	{
+		static const char digits[] = "0123456789abcdef";
+
+		std::vector<std::string> keys(count);
+		for (std::string& key : keys) {
+			key.resize(32);
+			for (char& c : key) {
+				c = digits[random() % 16];
+			}
+		}
+		return keys;
+	}
+
+	/**
+	 * 按 Zipf 分布（指数为 1）从 keys 中抽取 count 个键：第 i 热的键被抽中的概率与 1/i 成正比。
+	 */
+	std::vector<long> makeZipfianKeys(const std::vector<long>& keys, size_t count, std::mt19937_64& random)
+	{
+		std::vector<double> cumulative(keys.size());
+		double total = 0;
+		for (size_t i = 0; i < keys.size(); i++) {
+			total += 1.0 / double(i + 1);
+			cumulative[i] = total;
+		}
+
+		std::uniform_real_distribution<double> uniform(0, total);
+		std::vector<long> samples(count);
+		for (long& sample : samples) {
+			size_t rank = std::lower_bound(cumulative.begin(), cumulative.end(), uniform(random)) - cumulative.begin();
+			sample = keys[std::min(rank, keys.size() - 1)];
+		}
+		return samples;
+	}
+
+	/**
+	 * 在一棵新树上依次测量随机插入、随机命中查找和随机删除。用于对比不同实现的红黑树。
+	 */
+	template <typename Tree>
+	void profileInsertLookupRemove(
+		PerfEventProfiler& profiler,
+		const std::string& prefix,
+		const std::vector<long>& keys,
+		const std::vector<long>& shuffledKeys
+	)
+	{
+		Tree tree;
+
+		profiler.measure(prefix + " setData (random)", keys.size(), [&] {
+			for (long key : keys) {
+				tree.setData(key, key);
+			}
+		}).print(stdout);
+
+		profiler.measure(prefix + " hasKey (random hit)", keys.size(), [&] {
+			long count = 0;
+			for (long key : shuffledKeys) {
+				count += tree.hasKey(key);
+			}
+			sink = count;
+		}).print(stdout);
+
+		profiler.measure(prefix + " removeKey (random)", keys.size(), [&] {
+			for (long key : shuffledKeys) {
+				tree.removeKey(key);
+			}
+		}).print(stdout);
+	}
+
+}
+
+int main(int argc, char* argv[])
+{
+	size_t nodeCount = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+	if (nodeCount == 0) {
+		std::fprintf(stderr, "usage: %s [node count]\n", argv[0]);
+		return 1;
+	}
+
+	PerfEventProfiler profiler;
+	if (!profiler.getUnavailableReason().empty()) {
+		std::printf("hardware counters unavailable (%s). reporting time only.\n\n", 
+			profiler.getUnavailableReason().c_str());
+	}
+
+	std::printf("node count: %zu\n\n", nodeCount);
+	PerfEventReport::printHeader(stdout);
+
+	std::mt19937_64 random(2022);
+	std::vector<long> keys = makeKeys(nodeCount, random);
+
+	std::vector<long> shuffledKeys = keys;
+	std::shuffle(shuffledKeys.begin(), shuffledKeys.end(), random);
+
+	std::vector<long> sortedKeys = keys;
+	std::sort(sortedKeys.begin(), sortedKeys.end());
+
+	RedBlackTree<long, long> tree;
+
+	profiler.measure("setData (random insert)", nodeCount, [&] {
+		for (long key : keys) {
+			tree.setData(key, key);
+		}
+	}).print(stdout);
+
+	profiler.measure("getData (random hit)", nodeCount, [&] {
+		long sum = 0;
+		for (long key : shuffledKeys) {
+			sum += tree.getData(key);
+		}
+		sink = sum;
+	}).print(stdout);
+
+	profiler.measure("getData (ascending)", nodeCount, [&] {
+		long sum = 0;
+		for (long key : sortedKeys) {
+			sum += tree.getData(key);
+		}
+		sink = sum;
+	}).print(stdout);
+
+	profiler.measure("hasKey (random miss)", nodeCount, [&] {
+		long count = 0;
+		for (long key : shuffledKeys) {
+			count += tree.hasKey(key + 1);
+		}
+		sink = count;
+	}).print(stdout);
+
+	profiler.measure("forEach (full scan)", nodeCount, [&] {
+		long sum = 0;
+		tree.forEach([&sum] (const long&, long& data) {
+			sum += data;
+		});
+		sink = sum;
+	}).print(stdout);
+
+	// 反复删除、插入，打乱节点在内存中的顺序。
+	profiler.measure("removeKey + setData (churn)", nodeCount * 2, [&] {
+		for (size_t i = 0; i < nodeCount; i++) {
+			long key = shuffledKeys[i];
+			tree.removeKey(key);
+			tree.setData(key, key);
+		}
+	}).print(stdout);
+
+	profiler.measure("getData (random, after churn)", nodeCount, [&] {
+		long sum = 0;
+		for (long key : keys) {
+			sum += tree.getData(key);
+		}
+		sink = sum;
+	}).print(stdout);
+
+	profiler.measure("forEach (after churn)", nodeCount, [&] {
+		long sum = 0;
+		tree.forEach([&sum] (const long&, long& data) {
+			sum += data;
+		});
+		sink = sum;
+	}).print(stdout);
+
+	profiler.measure("compactLayout (full pass)", nodeCount, [&] {
+		while (!tree.compactLayout(4096)) {
+		}
+	}).print(stdout);
+
+	profiler.measure("getData (random, compacted)", nodeCount, [&] {
+		long sum = 0;
+		for (long key : keys) {
+			sum += tree.getData(key);
+		}
+		sink = sum;
+	}).print(stdout);
+
+	profiler.measure("forEach (compacted)", nodeCount, [&] {
+		long sum = 0;
+		tree.forEach([&sum] (const long&, long& data) {
+			sum += data;
+		});
+		sink = sum;
+	}).print(stdout);
+
+	// 热键缓存：Zipf 分布的读取。
+	std::vector<long> zipfianKeys = makeZipfianKeys(shuffledKeys, nodeCount, random);
+
+	profiler.measure("getData (zipfian)", nodeCount, [&] {
+		long sum = 0;
+		for (long key : zipfianKeys) {
+			sum += tree.getData(key);
+		}
+		sink = sum;
+	}).print(stdout);
+
+	tree.enableHotKeyCache(std::max<size_t>(nodeCount / 100, 1));
+
+	profiler.measure("getData (zipfian, hot key cache)", nodeCount, [&] {
+		long sum = 0;
+		for (long key : zipfianKeys) {
+			sum += tree.getData(key);
+		}
+		sink = sum;
+	}).print(stdout);
+
+	std::printf(
+		"    (hot key cache hit rate: %.1f%%)\n",
+		100.0 * double(tree.getHotKeyCacheHitCount())
+			/ double(tree.getHotKeyCacheHitCount() + tree.getHotKeyCacheMissCount())
+	);
+
+	tree.disableHotKeyCache();
+
+	// 计数：同样的 Zipf 分布键流，比较“先查再写”与一次查找的 upsert.
+	RedBlackTree<long, long> counters;
+
+	profiler.measure("hasKey + getData/setData (counter)", nodeCount, [&] {
+		for (long key : zipfianKeys) {
+			if (counters.hasKey(key)) {
+				counters.setData(key, counters.getData(key) + 1);
+			}
+			else {
+				counters.setData(key, 1);
+			}
+		}
+	}).print(stdout);
+
+	counters.clear();
+
+	profiler.measure("upsert (counter)", nodeCount, [&] {
+		for (long key : zipfianKeys) {
+			counters.upsert(key, [] (long& count) {
+				count++;
+			});
+		}
+	}).print(stdout);
+
+	// 哈希索引：与上面不带索引的同名负载对比。
+	profiler.measure("enableHashIndex (build)", nodeCount, [&] {
+		tree.enableHashIndex();
+	}).print(stdout);
+
+	profiler.measure("getData (random hit, hash index)", nodeCount, [&] {
+		long sum = 0;
+		for (long key : keys) {
+			sum += tree.getData(key);
+		}
+		sink = sum;
+	}).print(stdout);
+
+	profiler.measure("hasKey (random miss, hash index)", nodeCount, [&] {
+		long count = 0;
+		for (long key : shuffledKeys) {
+			count += tree.hasKey(key + 1);
+		}
+		sink = count;
+	}).print(stdout);
+
+	profiler.measure("removeKey + setData (hash index)", nodeCount * 2, [&] {
+		for (size_t i = 0; i < nodeCount; i++) {
+			long key = shuffledKeys[i];
+			tree.removeKey(key);
+			tree.setData(key, key);
+		}
+	}).print(stdout);
+
+	std::printf(
+		"    (hash index memory: %zu bytes, %.1f bytes/key)\n", 
+		tree.getHashIndexMemoryUsage(), 
+		double(tree.getHashIndexMemoryUsage()) / double(nodeCount)
+	);
+
+	tree.disableHashIndex();
+
+	profiler.measure("popMin (drain)", nodeCount, [&] {
+		long sum = 0;
+		while (!tree.isEmpty()) {
+			sum += tree.popMin().second;
+		}
+		sink = sum;
+	}).print(stdout);
+
+	// 归并：键轮流分到 4 棵树中，每棵树再覆盖写入一部分其他树的键。
+	const size_t MERGE_TREE_COUNT = 4;
+	std::vector<RedBlackTree<long, long>> mergeTrees(MERGE_TREE_COUNT);
+	std::vector<RedBlackTree<long, long>*> mergeTreePointers;
+	for (size_t i = 0; i < nodeCount; i++) {
+		mergeTrees[i % MERGE_TREE_COUNT].setData(keys[i], keys[i]);
+		if (i % 8 == 0) {
+			mergeTrees[(i + 1) % MERGE_TREE_COUNT].setData(keys[i], -keys[i]);
+		}
+	}
+	for (RedBlackTree<long, long>& mergeTree : mergeTrees) {
+		mergeTreePointers.push_back(&mergeTree);
+	}
+
+	profiler.measure("merge iterator (4 trees)", nodeCount, [&] {
+		long sum = 0;
+		for (RedBlackTreeMergeIterator<long, long> it(mergeTreePointers); it.isValid(); it.next()) {
+			sum += it.data();
+		}
+		sink = sum;
+	}).print(stdout);
+
+	// 自顶向下与自底向上的红黑树，使用相同的键。
+	profileInsertLookupRemove<TopDownRedBlackTree<long, long>>(profiler, "top-down", keys, shuffledKeys);
+	profileInsertLookupRemove<RedBlackTree<long, long>>(profiler, "bottom-up", keys, shuffledKeys);
+
+	// 并发：键按下标轮流分给各线程。先并发插入，再并发地混合读写（90% hasKey，10% setData 覆盖写）。
+	for (size_t threadCount : { 1, 4 }) {
+		ConcurrentRedBlackTree<long, long> concurrentTree;
+
+		auto runThreads = [&] (auto&& work) {
+			std::vector<std::thread> workers;
+			for (size_t worker = 0; worker < threadCount; worker++) {
+				workers.emplace_back([&, worker] {
+					work(worker);
+				});
+			}
+			for (std::thread& worker : workers) {
+				worker.join();
+			}
+		};
+
+		profiler.measure("concurrent setData (" + std::to_string(threadCount) + " thr)", nodeCount, [&] {
+			runThreads([&] (size_t worker) {
+				for (size_t i = worker; i < nodeCount; i += threadCount) {
+					concurrentTree.setData(keys[i], keys[i]);
+				}
+			});
+		}).print(stdout);
+
+		profiler.measure("concurrent 90% hasKey (" + std::to_string(threadCount) + " thr)", nodeCount, [&] {
+			std::vector<size_t> foundCounts(threadCount, 0);
+			runThreads([&] (size_t worker) {
+				for (size_t i = worker; i < nodeCount; i += threadCount) {
+					if (i % 10 != 0) {
+						foundCounts[worker] += concurrentTree.hasKey(shuffledKeys[i]);
+					}
+					else {
+						concurrentTree.setData(shuffledKeys[i], keys[i]);
+					}
+				}
+			});
+			size_t found = 0;
+			for (size_t count : foundCounts) {
+				found += count;
+			}
+			sink = found;
+		}).print(stdout);
+	}
+
+	// 写缓冲：与第一行 setData (random insert) 写入相同的键，包括最后一次 flush.
+	profiler.measure("buffered setData (random insert)", nodeCount, [&] {
+		BufferedRedBlackTree<long, long> bufferedTree;
+		for (long key : keys) {
+			bufferedTree.setData(key, key);
+		}
+		bufferedTree.flush();
+		sink = bufferedTree.getTree().isEmpty();
+	}).print(stdout);
+
+	// 分页：只有 10% 的节点常驻内存。99% 的读落在连续的 1% 键上，其余均匀分布。
+	PagedRedBlackTreeOptions pagedOptions;
+	pagedOptions.residentNodeBudget = nodeCount / 10;
+	pagedOptions.pageNodeCount = 512;
+	PagedRedBlackTree<long, long> pagedTree("RedBlackTreeProfile.swap", pagedOptions);
+
+	profiler.measure("paged setData (ascending)", nodeCount, [&] {
+		for (long key : sortedKeys) {
+			pagedTree.setData(key, key);
+		}
+	}).print(stdout);
+
+	size_t hotKeyCount = std::max<size_t>(nodeCount / 100, 1);
+	size_t pageFaultsBefore = pagedTree.getPageFaultCount();
+
+	profiler.measure("paged getData (skewed)", nodeCount, [&] {
+		long sum = 0;
+		for (size_t i = 0; i < nodeCount; i++) {
+			if (random() % 100 != 0) {
+				sum += pagedTree.getData(sortedKeys[nodeCount / 2 + random() % hotKeyCount - hotKeyCount / 2]);
+			}
+			else {
+				sum += pagedTree.getData(sortedKeys[random() % nodeCount]);
+			}
+		}
+		sink = sum;
+	}).print(stdout);
+
+	std::printf(
+		"    (resident nodes: %zu, page faults: %zu)\n",
+		pagedTree.getResidentNodeCount(),
+		pagedTree.getPageFaultCount() - pageFaultsBefore
+	);
+
+	// 持久化：三种落盘策略，各用 1 个和 8 个并发写者。每次写入都等待落盘（NONE 除外），
+	// 耗时主要取决于磁盘的 fdatasync，因此只写少量元素。数据目录在当前目录下，测完删除。
+	const size_t DURABLE_OPERATION_COUNT = std::min<size_t>(nodeCount, 2000);
+	const std::string durableDirectory = "RedBlackTreeProfile.durable";
+	const DurableSyncPolicy durablePolicies[] = {
+		DurableSyncPolicy::PER_WRITE, DurableSyncPolicy::GROUP_COMMIT, DurableSyncPolicy::NONE
+	};
+	const char* const durablePolicyNames[] = { "PER_WRITE", "GROUP_COMMIT", "NONE" };
+
+	for (size_t policy = 0; policy < 3; policy++) {
+		for (size_t writerCount : { 1, 8 }) {
+			std::remove((durableDirectory + "/wal").c_str());
+
+			DurableRedBlackTreeOptions durableOptions;
+			durableOptions.syncPolicy = durablePolicies[policy];
+			durableOptions.checkpointInterval = 0;
+			std::vector<std::vector<double>> latencies(writerCount);
+
+			{
+				DurableRedBlackTree<long, long> durableTree(durableDirectory, durableOptions);
+				std::string name = std::string("durable setData (") + durablePolicyNames[policy] 
+					+ ", " + std::to_string(writerCount) + " thr)";
+
+				profiler.measure(name, DURABLE_OPERATION_COUNT, [&] {
+					std::vector<std::thread> writers;
+					for (size_t writer = 0; writer < writerCount; writer++) {
+						writers.emplace_back([&, writer] {
+							for (size_t i = writer; i < DURABLE_OPERATION_COUNT; i += writerCount) {
+								auto start = std::chrono::steady_clock::now();
+								durableTree.setData(keys[i], keys[i]);
+								latencies[writer].push_back(std::chrono::duration<double, std::micro>(
+									std::chrono::steady_clock::now() - start
+								).count());
+							}
+						});
+					}
+					for (std::thread& writer : writers) {
+						writer.join();
+					}
+				}).print(stdout);
+			}
+
+			std::vector<double> allLatencies;
+			for (const std::vector<double>& writerLatencies : latencies) {
+				allLatencies.insert(allLatencies.end(), writerLatencies.begin(), writerLatencies.end());
+			}
+			std::sort(allLatencies.begin(), allLatencies.end());
+			std::printf(
+				"    (latency p50: %.1f us, p99: %.1f us)\n",
+				allLatencies[allLatencies.size() / 2],
+				allLatencies[allLatencies.size() * 99 / 100]
+			);
+		}
+	}
+	std::remove((durableDirectory + "/wal").c_str());
+	std::remove((durableDirectory + "/snapshot").c_str());
+	std::remove(durableDirectory.c_str());
+
+	// 字符串键。
+	std::vector<std::string> stringKeys = makeStringKeys(nodeCount, random);
+	RedBlackTree<std::string, long> stringTree;
+
+	profiler.measure("string setData (random insert)", nodeCount, [&] {
+		long index = 0;
+		for (const std::string& key : stringKeys) {
+			stringTree.setData(key, index++);
+		}
+	}).print(stdout);
+
+	std::shuffle(stringKeys.begin(), stringKeys.end(), random);
+
+	profiler.measure("string getData (random hit)", nodeCount, [&] {
+		long sum = 0;
+		for (const std::string& key : stringKeys) {
+			sum += stringTree.getData(key);
+		}
+		sink = sum;
+	}).print(stdout);
+
+	return 0;
+}
@@ -0,0 +1,51 @@
+/**
+ * Red Black Tree Serializer H
+ * by Flower Black
+ * 2022.1
+ * at Yushan County, Shangrao, Jiangxi
+ */
+
+#pragma once
+
+#include <string>
+#include <type_traits>
+
+/**
+ * 键与数据的二进制序列化方式。
+ * 默认实现按内存原样拷贝，只适用于可平凡复制（trivially copyable）的类型。
+ * 其他类型可以通过特化本模板来支持。
+ */
+template <typename ValueType>
+struct RedBlackTreeSerializer {
+	static_assert(
+		std::is_trivially_copyable<ValueType>::value,
+		"please specialize RedBlackTreeSerializer for non trivially copyable types."
+	);
+
+	/**
+	 * 将值追加到输出缓冲区末尾。
+	 *
+	 * @param out 输出缓冲区。
+	 * @param value 待写入的值。
+	 */
+	static void write(std::string& out, const ValueType& value);
+
+	/**
+	 * 从缓冲区中读出一个值，并将游标后移。
+	 *
+	 * @param cursor 读取位置。读取成功后会指向下一个值的开头。
+	 * @param end 缓冲区的末尾。
+	 * @param value 读取结果。
+	 * @return 剩余数据是否足够读出一个完整的值。
+	 */
+	static bool read(const char*& cursor, const char* end, ValueType& value);
+};
+
+/**
+ * std::string 的序列化方式：先写长度，再写内容。
+ */
+template <>
+struct RedBlackTreeSerializer<std::string> {
+	static void write(std::string& out, const std::string& value);
+	static bool read(const char*& cursor, const char* end, std::string& value);
+};
@@ -0,0 +1,63 @@
+/**
+ * Red Black Tree Serializer Hpp
+ * by Flower Black
+ * 2022.1
+ * at Yushan County, Shangrao, Jiangxi
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#include "RedBlackTreeSerializer.h"
+
+template<typename ValueType>
+void RedBlackTreeSerializer<ValueType>::write(std::string& out, const ValueType& value)
+{
+	out.append(reinterpret_cast<const char*>(&value), sizeof(ValueType));
+}
+
+template<typename ValueType>
+bool RedBlackTreeSerializer<ValueType>::read(
+	const char*& cursor,
+	const char* end,
+	ValueType& value
+)
+{
+	if (static_cast<size_t>(end - cursor) < sizeof(ValueType)) {
+		return false; // 数据不完整。
+	}
+
+	std::memcpy(&value, cursor, sizeof(ValueType));
+	cursor += sizeof(ValueType);
+	return true;
+}
+
+inline void RedBlackTreeSerializer<std::string>::write(std::string& out, const std::string& value)
+{
+	uint64_t length = value.size();
+	out.append(reinterpret_cast<const char*>(&length), sizeof(length));
+	out.append(value);
+}
+
+inline bool RedBlackTreeSerializer<std::string>::read(
+	const char*& cursor,
+	const char* end,
+	std::string& value
+)
+{
+	uint64_t length;
+	if (static_cast<size_t>(end - cursor) < sizeof(length)) {
+		return false;
+	}
+	std::memcpy(&length, cursor, sizeof(length));
+
+	if (static_cast<uint64_t>(end - cursor) - sizeof(length) < length) {
+		return false; // 内容被截断。
+	}
+
+	value.assign(cursor + sizeof(length), static_cast<size_t>(length));
+	cursor += sizeof(length) + length;
+	return true;
+}
@@ -0,0 +1,145 @@
+/**
+ * Top Down Red Black Tree H
+ * by Flower Black
+ * 2022.1
+ * at Yushan County, Shangrao, Jiangxi
+ */
+
+#pragma once
+
+#include "RedBlackTreeNodeData.h"
+
+/**
+ * 自顶向下（单趟）红黑树。
+ * 
+ * 与 RedBlackTree 不同，插入和删除在从根向下的唯一一趟中完成平衡修复，
+ * 不需要再沿父节点向上回溯，因此节点中没有父节点指针。
+ * 节点更小，每次更新写入的缓存行也更少。
+ * 
+ * 删除时，若目标节点有孩子，会把前驱节点的键和数据移动到目标节点中，再删去前驱节点。
+ */
+template <typename KeyType, typename DataType>
+class TopDownRedBlackTree {
+
+public:
+	/** 树的生命相关操作。 */
+	TopDownRedBlackTree();
+	~TopDownRedBlackTree();
+
+	TopDownRedBlackTree(const TopDownRedBlackTree&) = delete;
+	TopDownRedBlackTree& operator = (const TopDownRedBlackTree&) = delete;
+
+	/**
+	 * 清空树中所有元素。
+	 */
+	void clear();
+
+public:
+	/** 树的基本查询操作。 */
+
+	/**
+	 * 判断键是否在树里。
+	 * 
+	 * @param queryKey 待判断的键。
+	 * @return 是否在树上找到了对应键。
+	 */
+	bool hasKey(const KeyType& queryKey);
+
+	/**
+	 * 根据键获取数据。
+	 * 
+	 * @param key 键。
+	 * @return 键对应的数据。
+	 * @exception runtime_error 如果无法找到键，会抛出异常。
+	 */
+	DataType& getData(const KeyType& key);
+
+	/**
+	 * 设置数据。如果键已经存在，会更新原有数据。
+	 * 
+	 * @param key 键。
+	 * @param data 数据。
+	 */
+	TopDownRedBlackTree<KeyType, DataType>& setData(const KeyType& key, const DataType& data);
+
+	/**
+	 * 删除键。
+	 * 找不到键时，树的内容不变，但向下途中做过的旋转和着色会保留（树依然合法）。
+	 * 
+	 * @param key 键。
+	 * @return 红黑树对象自身。
+	 * @exception runtime_error 如果无法找到键，会抛出异常。
+	 */
+	TopDownRedBlackTree<KeyType, DataType>& removeKey(const KeyType& key);
+
+	/**
+	 * 按键从小到大的顺序访问每个元素。遍历过程中不可修改树的结构。
+	 * 
+	 * @param function 访问函数，形如 void(const KeyType& key, DataType& data)。
+	 */
+	template <typename Function>
+	void forEach(Function&& function);
+
+private:
+	enum class NodeColor {
+		RED, BLACK
+	};
+	struct Node : RedBlackTreeNodeData<DataType> {
+		KeyType key;
+		NodeColor color = NodeColor::RED;
+
+		/**
+		 * children[0] 为左孩子，children[1] 为右孩子。
+		 * 自顶向下的算法按方向下标统一处理左右两种对称情况。
+		 */
+		Node* children[2] = { nullptr, nullptr };
+	};
+
+	/**
+	 * 树高的上限。红黑树的高度不超过 2 log2(n + 1)，足够容纳任何能放进内存的树。
+	 */
+	static constexpr int MAX_HEIGHT = 128;
+
+private:
+	/**
+	 * 判断节点是否为红色。空节点视为黑色。
+	 */
+	static bool isRed(const Node* node);
+
+	/**
+	 * 单旋转。node 的 !direction 侧孩子成为子树新的根。
+	 * 旋转后，新根为黑色，原来的根为红色。
+	 * 
+	 * @param node 子树的根。
+	 * @param direction 旋转方向。0 为左旋，1 为右旋。
+	 * @return 子树新的根。
+	 */
+	static Node* rotateSingle(Node* node, int direction);
+
+	/**
+	 * 双旋转：先对 !direction 侧孩子做反向单旋转，再对 node 做单旋转。
+	 * 
+	 * @param node 子树的根。
+	 * @param direction 旋转方向。
+	 * @return 子树新的根。
+	 */
+	static Node* rotateDouble(Node* node, int direction);
+
+	/**
+	 * 释放所有节点。通过不断右旋把树拉成链再逐个释放，不使用递归和额外空间。
+	 */
+	void cleanup();
+
+private:
+	/**
+	 * 根节点。
+	 */
+	Node* root = nullptr;
+
+	/**
+	 * 假的树根，供 setData 和 removeKey 使用。每次使用前令它的右孩子为真正的根。
+	 * 作为成员只构造一次，避免每次修改都构造一个键和数据。
+	 */
+	Node head;
+
+};
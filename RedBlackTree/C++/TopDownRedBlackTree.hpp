@@ -0,0 +1,342 @@
+/**
+ * Top Down Red Black Tree Hpp
+ * by Flower Black
+ * 2022.1
+ * at Yushan County, Shangrao, Jiangxi
+ */
+
+#pragma once
+
+#include <stdexcept>
+#include <utility>
+
+#include "TopDownRedBlackTree.h"
+
+template<typename KeyType, typename DataType>
+TopDownRedBlackTree<KeyType, DataType>::TopDownRedBlackTree()
+{
+}
+
+template<typename KeyType, typename DataType>
+TopDownRedBlackTree<KeyType, DataType>::~TopDownRedBlackTree()
+{
+	this->cleanup();
+}
+
+template<typename KeyType, typename DataType>
+void TopDownRedBlackTree<KeyType, DataType>::clear()
+{
+	this->cleanup();
+}
+
+template<typename KeyType, typename DataType>
+bool TopDownRedBlackTree<KeyType, DataType>::hasKey(const KeyType& queryKey)
+{
+	Node* currentNode = this->root;
+
+	while (currentNode != nullptr) {
+		if (queryKey == currentNode->key) {
+			return true; // 找到对应键。
+		}
+		else if (queryKey < currentNode->key) {
+			currentNode = currentNode->children[0]; // 目标键小于当前键，向左查找。
+		}
+		else {
+			currentNode = currentNode->children[1]; // 目标键大于当前键，向右查找。
+		}
+	}
+
+	return false; // 找不到键。
+}
+
+template<typename KeyType, typename DataType>
+DataType& TopDownRedBlackTree<KeyType, DataType>::getData(const KeyType& key)
+{
+	Node* currentNode = this->root;
+
+	while (currentNode != nullptr) {
+		if (key == currentNode->key) {
+			return currentNode->data; // 找到对应键。
+		}
+		else if (key < currentNode->key) {
+			currentNode = currentNode->children[0]; // 目标键小于当前键，向左查找。
+		}
+		else {
+			currentNode = currentNode->children[1]; // 目标键大于当前键，向右查找。
+		}
+	}
+
+	throw std::runtime_error("could not find your key in the object."); // 找不到对应键。抛出异常。
+}
+
+template<typename KeyType, typename DataType>
+TopDownRedBlackTree<KeyType, DataType>& TopDownRedBlackTree<KeyType, DataType>::setData(
+	const KeyType& key,
+	const DataType& data
+)
+{
+	// 如果树是空的，插入节点设为根即可。
+	if (this->root == nullptr) {
+		this->root = new Node;
+		this->root->key = key;
+		this->root->data = data;
+		this->root->color = NodeColor::BLACK;
+		return *this;
+	}
+
+	/*
+		向下查找插入位置。途中：
+		  1. 遇到两个孩子都是红色的节点，就做反色：节点变红，孩子变黑。
+		     这样一来，到达底部时父节点的兄弟一定不是红色，插入后只需旋转即可修复。
+		  2. 反色或插入后若出现“连续红色节点”，在祖父处旋转修复。
+		     修复需要改写曾祖父的孩子指针，所以一路保存 曾祖父、祖父、父节点 三个节点。
+		
+		head 是假的树根，它的右孩子是真正的根。这样根节点的旋转不需要特殊处理。
+	*/
+	Node& head = this->head;
+	head.children[0] = nullptr;
+	head.children[1] = this->root;
+
+	Node* greatGrandpa = &head;
+	Node* grandpa = nullptr;
+	Node* father = nullptr;
+	Node* currentNode = this->root;
+	Node* createdNode = nullptr;
+	int direction = 0;
+	int lastDirection = 0;
+
+	while (true) {
+		if (currentNode == nullptr) {
+			// 到达底部，插入红色的新节点。
+			currentNode = new Node;
+			createdNode = currentNode;
+			currentNode->key = key;
+			currentNode->data = data;
+			father->children[direction] = currentNode;
+		}
+		else if (isRed(currentNode->children[0]) && isRed(currentNode->children[1])) {
+			// 反色。
+			currentNode->color = NodeColor::RED;
+			currentNode->children[0]->color = NodeColor::BLACK;
+			currentNode->children[1]->color = NodeColor::BLACK;
+		}
+
+		// 修复“连续红色节点”问题。父节点是红色的，所以祖父一定存在。
+		if (isRed(currentNode) && isRed(father)) {
+			int grandpaDirection = (greatGrandpa->children[1] == grandpa);
+
+			if (currentNode == father->children[lastDirection]) {
+				// 当前节点、父节点在同一侧，单旋转。
+				greatGrandpa->children[grandpaDirection] = rotateSingle(grandpa, !lastDirection);
+			}
+			else {
+				// 当前节点、父节点不在同一侧，双旋转。
+				greatGrandpa->children[grandpaDirection] = rotateDouble(grandpa, !lastDirection);
+			}
+		}
+
+		if (key == currentNode->key) {
+			if (currentNode != createdNode) {
+				currentNode->data = data; // 键已经存在，更新数据。
+			}
+			break;
+		}
+
+		lastDirection = direction;
+		direction = (currentNode->key < key);
+
+		if (grandpa != nullptr) {
+			greatGrandpa = grandpa;
+		}
+		grandpa = father;
+		father = currentNode;
+		currentNode = currentNode->children[direction];
+	}
+
+	this->root = head.children[1];
+	this->root->color = NodeColor::BLACK; // 根节点始终为黑色。
+	return *this;
+}
+
+template<typename KeyType, typename DataType>
+TopDownRedBlackTree<KeyType, DataType>& TopDownRedBlackTree<KeyType, DataType>::removeKey(
+	const KeyType& key
+)
+{
+	if (this->root == nullptr) {
+		throw std::runtime_error("could not find your key in the object."); // 找不到对应键。抛出异常。
+	}
+
+	/*
+		向下查找目标，并一直找到目标的前驱（即最终被删除的叶侧节点）。途中保证当前节点是红色的，
+		这样最后删掉的节点一定是红色，删除后不会破坏黑色高度。
+		若当前节点和它要去的孩子都是黑色，就把红色“推”下来：
+		  1. 另一个孩子是红色：对当前节点旋转，让红孩子成为它的父节点。
+		  2. 兄弟的孩子都是黑色：反色，父节点变黑，当前节点与兄弟变红。
+		  3. 兄弟有红孩子：在父节点处单旋转或双旋转，再重新着色。
+		
+		head 是假的树根，它的右孩子是真正的根。
+	*/
+	Node& head = this->head;
+	head.children[0] = nullptr;
+	head.children[1] = this->root;
+
+	Node* grandpa = nullptr;
+	Node* father = nullptr;
+	Node* currentNode = &head;
+	Node* foundNode = nullptr;
+	int direction = 1;
+
+	while (currentNode->children[direction] != nullptr) {
+		int lastDirection = direction;
+
+		grandpa = father;
+		father = currentNode;
+		currentNode = currentNode->children[direction];
+		direction = (currentNode->key < key);
+
+		if (key == currentNode->key) {
+			foundNode = currentNode; // 记下目标，继续向左找它的前驱。
+		}
+
+		if (!isRed(currentNode) && !isRed(currentNode->children[direction])) {
+			if (isRed(currentNode->children[!direction])) {
+				// 情况 1.
+				father->children[lastDirection] = rotateSingle(currentNode, direction);
+				father = father->children[lastDirection];
+			}
+			else {
+				Node* sibling = father->children[!lastDirection];
+
+				if (sibling != nullptr) {
+					if (!isRed(sibling->children[!lastDirection]) && !isRed(sibling->children[lastDirection])) {
+						// 情况 2.
+						father->color = NodeColor::BLACK;
+						sibling->color = NodeColor::RED;
+						currentNode->color = NodeColor::RED;
+					}
+					else {
+						// 情况 3. 父节点一定是红色的，因此它不是假树根，祖父一定存在。
+						int fatherDirection = (grandpa->children[1] == father);
+
+						if (isRed(sibling->children[lastDirection])) {
+							grandpa->children[fatherDirection] = rotateDouble(father, lastDirection);
+						}
+						else {
+							grandpa->children[fatherDirection] = rotateSingle(father, lastDirection);
+						}
+
+						// 重新着色。
+						Node* subtreeRoot = grandpa->children[fatherDirection];
+						currentNode->color = NodeColor::RED;
+						subtreeRoot->color = NodeColor::RED;
+						subtreeRoot->children[0]->color = NodeColor::BLACK;
+						subtreeRoot->children[1]->color = NodeColor::BLACK;
+					}
+				}
+			}
+		}
+	}
+
+	if (foundNode != nullptr) {
+		// 此时 currentNode 是目标的前驱（或目标本身），它最多只有一个孩子。
+		// 把它的内容移到目标节点，然后用它的孩子顶替它的位置。
+		if (foundNode != currentNode) {
+			foundNode->key = std::move(currentNode->key);
+			foundNode->data = std::move(currentNode->data);
+		}
+		father->children[father->children[1] == currentNode] =
+			currentNode->children[currentNode->children[0] == nullptr];
+		delete currentNode;
+	}
+
+	// 更新根节点，并把它设为黑色。
+	this->root = head.children[1];
+	if (this->root != nullptr) {
+		this->root->color = NodeColor::BLACK;
+	}
+
+	if (foundNode == nullptr) {
+		throw std::runtime_error("could not find your key in the object."); // 找不到对应键。抛出异常。
+	}
+
+	return *this;
+}
+
+template<typename KeyType, typename DataType>
+template<typename Function>
+void TopDownRedBlackTree<KeyType, DataType>::forEach(Function&& function)
+{
+	// 没有父节点指针，用栈记录回溯路径。
+	Node* path[MAX_HEIGHT];
+	int pathLength = 0;
+	Node* currentNode = this->root;
+
+	while (currentNode != nullptr || pathLength > 0) {
+		while (currentNode != nullptr) {
+			path[pathLength++] = currentNode;
+			currentNode = currentNode->children[0];
+		}
+
+		currentNode = path[--pathLength];
+		function(static_cast<const KeyType&>(currentNode->key), currentNode->data);
+		currentNode = currentNode->children[1];
+	}
+}
+
+template<typename KeyType, typename DataType>
+bool TopDownRedBlackTree<KeyType, DataType>::isRed(const Node* node)
+{
+	return node != nullptr && node->color == NodeColor::RED;
+}
+
+template<typename KeyType, typename DataType>
+typename TopDownRedBlackTree<KeyType, DataType>::Node* TopDownRedBlackTree<KeyType, DataType>::rotateSingle(
+	Node* node,
+	int direction
+)
+{
+	Node* targetRoot = node->children[!direction];
+
+	node->children[!direction] = targetRoot->children[direction];
+	targetRoot->children[direction] = node;
+
+	node->color = NodeColor::RED;
+	targetRoot->color = NodeColor::BLACK;
+
+	return targetRoot;
+}
+
+template<typename KeyType, typename DataType>
+typename TopDownRedBlackTree<KeyType, DataType>::Node* TopDownRedBlackTree<KeyType, DataType>::rotateDouble(
+	Node* node,
+	int direction
+)
+{
+	node->children[!direction] = rotateSingle(node->children[!direction], !direction);
+	return rotateSingle(node, direction);
+}
+
+template<typename KeyType, typename DataType>
+void TopDownRedBlackTree<KeyType, DataType>::cleanup()
+{
+	Node* currentNode = this->root;
+
+	while (currentNode != nullptr) {
+		if (currentNode->children[0] != nullptr) {
+			// 右旋，把左孩子提上来。
+			Node* leftChild = currentNode->children[0];
+			currentNode->children[0] = leftChild->children[1];
+			leftChild->children[1] = currentNode;
+			currentNode = leftChild;
+		}
+		else {
+			// 没有左孩子，释放当前节点，继续处理右子树。
+			Node* rightChild = currentNode->children[1];
+			delete currentNode;
+			currentNode = rightChild;
+		}
+	}
+
+	this->root = nullptr;
+}
@@ -0,0 +1,144 @@
+/**
+ * Work Stealing Thread Pool H
+ * by Flower Black
+ * 2022.1
+ * at Yushan County, Shangrao, Jiangxi
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * 工作窃取线程池。用于把树按子树拆分后并行处理。
+ * 
+ * 每个工作线程有自己的任务队列：自己从队尾取（后进先出，缓存友好），
+ * 空闲时从其他线程的队头偷（先进先出，偷到的往往是较大的子任务）。
+ * 等待任务组完成的线程不会空等，而是帮忙执行任务，因此任务可以嵌套地提交子任务。
+ */
+class WorkStealingThreadPool {
+
+public:
+	/**
+	 * 一组任务。可以等待组内所有任务完成。
+	 * 组内任务抛出的第一个异常会在 wait 时重新抛出。
+	 */
+	class TaskGroup {
+	public:
+		TaskGroup() = default;
+		TaskGroup(const TaskGroup&) = delete;
+		TaskGroup& operator = (const TaskGroup&) = delete;
+
+	private:
+		friend class WorkStealingThreadPool;
+
+		std::atomic<size_t> pendingTaskCount { 0 };
+		std::mutex exceptionMutex;
+		std::exception_ptr exception;
+	};
+
+public:
+	/** 线程池的生命相关操作。 */
+
+	/**
+	 * 创建线程池。
+	 * 
+	 * @param threadCount 参与计算的线程数（包括调用 wait 的线程）。为 0 时使用硬件线程数。
+	 */
+	explicit WorkStealingThreadPool(unsigned threadCount = 0);
+
+	/**
+	 * 停止并回收所有工作线程。调用前应等待所有任务组完成。
+	 */
+	~WorkStealingThreadPool();
+
+	WorkStealingThreadPool(const WorkStealingThreadPool&) = delete;
+	WorkStealingThreadPool& operator = (const WorkStealingThreadPool&) = delete;
+
+public:
+	/** 任务相关操作。 */
+
+	/**
+	 * 提交任务。工作线程提交的任务放进它自己的队列，其他线程提交的放进调用者专用的队列。
+	 * 
+	 * @param group 任务所属的组。
+	 * @param task 任务。
+	 */
+	void submit(TaskGroup& group, std::function<void()> task);
+
+	/**
+	 * 等待组内所有任务完成。等待期间当前线程会执行池中的任务。
+	 * 
+	 * @param group 任务组。
+	 * @exception 重新抛出组内任务抛出的第一个异常。
+	 */
+	void wait(TaskGroup& group);
+
+	/**
+	 * 参与计算的线程数（包括调用 wait 的线程）。
+	 */
+	unsigned size() const;
+
+private:
+	struct Task {
+		std::function<void()> function;
+		TaskGroup* group;
+	};
+
+	/**
+	 * 每个线程的任务队列。最后一个队列留给不属于线程池的调用者。
+	 */
+	struct TaskQueue {
+		std::mutex mutex;
+		std::deque<Task> tasks;
+	};
+
+private:
+	/**
+	 * 工作线程的主循环。
+	 * 
+	 * @param queueIndex 该线程的队列下标。
+	 */
+	void workerLoop(unsigned queueIndex);
+
+	/**
+	 * 取出并执行一个任务：先取自己队尾的，没有就从别的队列队头偷。
+	 * 
+	 * @param queueIndex 当前线程的队列下标。
+	 * @return 是否执行了任务。
+	 */
+	bool runOneTask(unsigned queueIndex);
+
+	/**
+	 * 当前线程在本线程池中的队列下标。
+	 */
+	unsigned currentQueueIndex() const;
+
+private:
+	std::vector<std::unique_ptr<TaskQueue>> queues;
+	std::vector<std::thread> workers;
+
+	/**
+	 * 所有队列中尚未被取走的任务数。工作线程据此决定是否休眠。
+	 */
+	std::atomic<size_t> queuedTaskCount { 0 };
+
+	std::mutex sleepMutex;
+	std::condition_variable sleepCondition;
+	bool stopping = false;
+
+	/**
+	 * 当前线程所属的线程池及其队列下标。不属于任何线程池时为 nullptr.
+	 */
+	inline static thread_local const WorkStealingThreadPool* currentPool = nullptr;
+	inline static thread_local unsigned currentPoolQueueIndex = 0;
+
+};
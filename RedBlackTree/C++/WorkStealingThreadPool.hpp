@@ -0,0 +1,166 @@
+/**
+ * Work Stealing Thread Pool Hpp
+ * by Flower Black
+ * 2022.1
+ * at Yushan County, Shangrao, Jiangxi
+ */
+
+#pragma once
+
+#include <utility>
+
+#include "WorkStealingThreadPool.h"
+
+inline WorkStealingThreadPool::WorkStealingThreadPool(unsigned threadCount)
+{
+	if (threadCount == 0) {
+		threadCount = std::thread::hardware_concurrency();
+	}
+	if (threadCount == 0) {
+		threadCount = 1;
+	}
+
+	// 调用者也参与计算，因此只需另外创建 threadCount - 1 个线程。
+	// 队列比工作线程多一个，最后一个留给调用者。
+	for (unsigned i = 0; i < threadCount; i++) {
+		this->queues.push_back(std::unique_ptr<TaskQueue>(new TaskQueue));
+	}
+	for (unsigned i = 0; i + 1 < threadCount; i++) {
+		this->workers.emplace_back(&WorkStealingThreadPool::workerLoop, this, i);
+	}
+}
+
+inline WorkStealingThreadPool::~WorkStealingThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(this->sleepMutex);
+		this->stopping = true;
+	}
+	this->sleepCondition.notify_all();
+
+	for (std::thread& worker : this->workers) {
+		worker.join();
+	}
+}
+
+inline void WorkStealingThreadPool::submit(TaskGroup& group, std::function<void()> task)
+{
+	group.pendingTaskCount.fetch_add(1, std::memory_order_relaxed);
+
+	TaskQueue& queue = *this->queues[this->currentQueueIndex()];
+	{
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.tasks.push_back(Task { std::move(task), &group });
+	}
+
+	this->queuedTaskCount.fetch_add(1, std::memory_order_release);
+
+	// 唤醒一个休眠的工作线程来偷这个任务。
+	// 先拿一下 sleepMutex，避免工作线程在检查完计数、即将休眠时错过通知。
+	{
+		std::lock_guard<std::mutex> lock(this->sleepMutex);
+	}
+	this->sleepCondition.notify_one();
+}
+
+inline void WorkStealingThreadPool::wait(TaskGroup& group)
+{
+	unsigned queueIndex = this->currentQueueIndex();
+
+	while (group.pendingTaskCount.load(std::memory_order_acquire) != 0) {
+		if (!this->runOneTask(queueIndex)) {
+			// 组内剩下的任务正被其他线程执行。
+			std::this_thread::yield();
+		}
+	}
+
+	if (group.exception) {
+		std::exception_ptr exception = group.exception;
+		group.exception = nullptr;
+		std::rethrow_exception(exception);
+	}
+}
+
+inline unsigned WorkStealingThreadPool::size() const
+{
+	return static_cast<unsigned>(this->queues.size());
+}
+
+inline void WorkStealingThreadPool::workerLoop(unsigned queueIndex)
+{
+	currentPool = this;
+	currentPoolQueueIndex = queueIndex;
+
+	while (true) {
+		if (this->runOneTask(queueIndex)) {
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(this->sleepMutex);
+		this->sleepCondition.wait(lock, [this] {
+			return this->stopping || this->queuedTaskCount.load(std::memory_order_acquire) != 0;
+		});
+		if (this->stopping) {
+			break;
+		}
+	}
+
+	currentPool = nullptr;
+}
+
+inline bool WorkStealingThreadPool::runOneTask(unsigned queueIndex)
+{
+	Task task;
+	bool found = false;
+
+	// 先从自己的队尾取。
+	{
+		TaskQueue& queue = *this->queues[queueIndex];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (!queue.tasks.empty()) {
+			task = std::move(queue.tasks.back());
+			queue.tasks.pop_back();
+			found = true;
+		}
+	}
+
+	// 再依次从其他队列的队头偷。
+	for (size_t offset = 1; !found && offset < this->queues.size(); offset++) {
+		TaskQueue& queue = *this->queues[(queueIndex + offset) % this->queues.size()];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (!queue.tasks.empty()) {
+			task = std::move(queue.tasks.front());
+			queue.tasks.pop_front();
+			found = true;
+		}
+	}
+
+	if (!found) {
+		return false;
+	}
+
+	this->queuedTaskCount.fetch_sub(1, std::memory_order_relaxed);
+
+	try {
+		task.function();
+	}
+	catch (...) {
+		std::lock_guard<std::mutex> lock(task.group->exceptionMutex);
+		if (!task.group->exception) {
+			task.group->exception = std::current_exception();
+		}
+	}
+
+	task.group->pendingTaskCount.fetch_sub(1, std::memory_order_release);
+	return true;
+}
+
+inline unsigned WorkStealingThreadPool::currentQueueIndex() const
+{
+	if (currentPool == this) {
+		return currentPoolQueueIndex;
+	}
+
+	// 不属于本线程池的线程共用最后一个队列。
+	return static_cast<unsigned>(this->queues.size() - 1);
+}